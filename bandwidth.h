@@ -0,0 +1,41 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __BANDWIDTH_H__
+#define __BANDWIDTH_H__
+
+/**
+ * CPU bandwidth limit of a process or a group. The processes under the limit
+ * can run for @quota ticks in total in every @period ticks. Once the quota
+ * is used up, the framework throttles the processes when the scheduler picks
+ * them, and parks them in @throttled until the period timer refills @runtime.
+ */
+struct bandwidth {
+	char name[48];				/* Whom this bandwidth limits */
+	unsigned int quota;			/* Ticks allowed to run in a period */
+	unsigned int period;		/* Length of the period in ticks */
+	unsigned int runtime;		/* Ticks remained in the current period */
+
+	struct list_head throttled;	/* Processes throttled by this bandwidth */
+	struct timer period_timer;	/* Refill @runtime every @period */
+
+	struct list_head list;		/* list head for listing bandwidths */
+
+	unsigned int nr_throttled;	/* # of times processes were throttled */
+	unsigned int throttled_ticks;
+								/* Sum of ticks processes were throttled */
+};
+
+#endif
@@ -0,0 +1,276 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+
+#include "types.h"
+#include "batch.h"
+
+/**
+ * States of a process in a lane
+ */
+enum {
+	BATCH_NEW,
+	BATCH_READY,
+	BATCH_RUNNING,
+	BATCH_EXITED,
+};
+
+/**
+ * Per-process state of the lanes. The ready queue of a lane is not kept as
+ * a list; @order tells the position of each process in the queue instead,
+ * so picking the next process is a masked minimum over the processes.
+ */
+struct batch_state {
+	lanes_t *state;
+	lanes_t *age;
+	lanes_t *order;		/* Position in the ready queue, or enqueue order */
+	lanes_t *epoch;		/* Aging epoch when queued */
+	lanes_t *first_run;	/* When the process ran first. -1 if not yet */
+};
+
+/**
+ * Pick @a in the lanes where @mask is set, and @b in the others. Vectors are
+ * passed around by macros and pointers, not to depend on the vector ABI.
+ */
+#define __select(mask, a, b)	(((mask) & (a)) | (~(mask) & (b)))
+
+static inline bool __any(const lanes_t *mask)
+{
+	int any = 0;
+
+	for (int l = 0; l < BATCH_LANES; l++) any |= (*mask)[l];
+	return any != 0;
+}
+
+/**
+ * Processes in the order of their earliest start among the lanes
+ */
+struct batch_fork {
+	int start;
+	unsigned int index;
+};
+
+static int __compare_forks(const void *a, const void *b)
+{
+	const struct batch_fork *fa = a, *fb = b;
+
+	if (fa->start != fb->start) return fa->start < fb->start ? -1 : 1;
+	return fa->index < fb->index ? -1 : fa->index > fb->index;
+}
+
+/**
+ * The key to pick the next process by into @key. The lower, the sooner
+ */
+static inline void __key(struct batch *b, struct batch_state *s, unsigned int i, lanes_t *key)
+{
+	switch (b->policy) {
+	case BATCH_SJF:
+		*key = b->lifespan[i];
+		break;
+	case BATCH_SRTF:
+		*key = b->lifespan[i] - s->age[i];
+		break;
+	case BATCH_PRIO:
+		*key = (int)b->aging_step * s->epoch[i] - b->prio[i];
+		break;
+	default:
+		*key = b->lifespan[i] & 0;
+		break;
+	}
+}
+
+int batch_simulate(struct batch *b)
+{
+	const unsigned int n = b->nr_processes;
+	const lanes_t zero = { 0 };
+	const bool requeue = b->policy == BATCH_RR || b->policy == BATCH_PRIO;
+	struct batch_state s;
+	lanes_t live = zero;
+	lanes_t head = zero, tail = zero;
+	struct batch_fork *forks;
+	unsigned int *active;		/* Processes forked in any lane and not yet
+								   exited in all, in the order of the index */
+	unsigned int nr_forks = 0, nr_active = 0;
+
+	s.state = calloc(n, sizeof(lanes_t));
+	s.age = calloc(n, sizeof(lanes_t));
+	s.order = calloc(n, sizeof(lanes_t));
+	s.epoch = calloc(n, sizeof(lanes_t));
+	s.first_run = calloc(n, sizeof(lanes_t));
+	forks = calloc(n, sizeof(*forks));
+	active = calloc(n, sizeof(*active));
+	if (n && !(s.state && s.age && s.order && s.epoch && s.first_run && forks && active)) {
+		free(s.state);
+		free(s.age);
+		free(s.order);
+		free(s.epoch);
+		free(s.first_run);
+		free(forks);
+		free(active);
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		s.first_run[i] = zero - 1;
+	}
+	for (unsigned int l = 0; l < b->nr_lanes && l < BATCH_LANES; l++) {
+		live[l] = -1;
+	}
+	b->makespan = b->nr_exited = b->response = b->turnaround = zero;
+
+	/**
+	 * A tick only visits the active processes. Otherwise, the processes not
+	 * forked yet or exited long ago make a tick as expensive as the whole
+	 * scenario, and the lanes fall behind simulating the variants one by one.
+	 */
+	for (unsigned int i = 0; i < n; i++) {
+		forks[i].start = b->start[i][0];
+		for (unsigned int l = 1; l < b->nr_lanes && l < BATCH_LANES; l++) {
+			if (b->start[i][l] < forks[i].start) forks[i].start = b->start[i][l];
+		}
+		forks[i].index = i;
+	}
+	qsort(forks, n, sizeof(*forks), __compare_forks);
+
+	for (unsigned int tick = 0; __any(&live); tick++) {
+		const lanes_t now = zero + (int)tick;
+		const lanes_t epoch = zero + (int)(b->aging_period ? tick / b->aging_period : 0);
+		lanes_t cur = zero - 1, ck = zero, co = zero;
+		lanes_t next = zero - 1, nk = zero, no = zero;
+		lanes_t has_cur = zero, preempt, pick;
+		unsigned int nr_left = 0;
+
+		/* Activate the processes due to fork in any lane, keeping the order */
+		for (; nr_forks < n && forks[nr_forks].start <= (int)tick; nr_forks++) {
+			unsigned int a = nr_active++;
+
+			for (; a && active[a - 1] > forks[nr_forks].index; a--) {
+				active[a] = active[a - 1];
+			}
+			active[a] = forks[nr_forks].index;
+		}
+
+		/* Fork processes on schedule to the tail of the ready queue */
+		for (unsigned int a = 0; a < nr_active; a++) {
+			unsigned int i = active[a];
+			lanes_t m = live & (s.state[i] == BATCH_NEW) & (b->start[i] <= now);
+
+			s.state[i] = __select(m, zero + BATCH_READY, s.state[i]);
+			s.order[i] = __select(m, tail, s.order[i]);
+			s.epoch[i] = __select(m, epoch, s.epoch[i]);
+			tail -= m;
+		}
+
+		/* Retire the current if completed, or put it back to compete */
+		for (unsigned int a = 0; a < nr_active; a++) {
+			unsigned int i = active[a];
+			lanes_t running = s.state[i] == BATCH_RUNNING;
+			lanes_t alive = running & (s.age[i] < b->lifespan[i]);
+			lanes_t done = running & ~alive;
+			lanes_t k;
+
+			s.state[i] = __select(done, zero + BATCH_EXITED, s.state[i]);
+			b->nr_exited -= done;
+			b->response += done & (s.first_run[i] - b->start[i]);
+			b->turnaround += done & (now - b->start[i]);
+
+			if (requeue) {
+				s.order[i] = __select(alive, tail, s.order[i]);
+				s.epoch[i] = __select(alive, epoch, s.epoch[i]);
+				tail -= alive;
+			}
+			cur = __select(alive, zero + (int)i, cur);
+			__key(b, &s, i, &k);
+			ck = __select(alive, k, ck);
+			co = __select(alive, s.order[i], co);
+			has_cur |= alive;
+		}
+
+		/* Find the first one with the lowest key in the ready queue */
+		for (unsigned int a = 0; a < nr_active; a++) {
+			unsigned int i = active[a];
+			lanes_t k, better;
+
+			__key(b, &s, i, &k);
+			better = (s.state[i] == BATCH_READY) &
+					((next < 0) | (k < nk) | ((k == nk) & (s.order[i] < no)));
+
+			next = __select(better, zero + (int)i, next);
+			nk = __select(better, k, nk);
+			no = __select(better, s.order[i], no);
+		}
+
+		/* Decide whether the current keeps the CPU */
+		switch (b->policy) {
+		case BATCH_SRTF:
+			preempt = has_cur & (next >= 0) & (nk < ck);
+			break;
+		case BATCH_RR:
+		case BATCH_PRIO:
+			preempt = has_cur & (next >= 0) & ((nk < ck) | ((nk == ck) & (no < co)));
+			break;
+		default:
+			preempt = zero;
+			break;
+		}
+		pick = (~has_cur | preempt) & (next >= 0);
+
+		/* The preempted by SRTF goes to the head of the ready queue */
+		if (b->policy == BATCH_SRTF) head += preempt;
+
+		for (unsigned int a = 0; a < nr_active; a++) {
+			unsigned int i = active[a];
+			lanes_t out = preempt & (cur == (int)i);
+			lanes_t in = pick & (next == (int)i);
+
+			s.state[i] = __select(out, zero + BATCH_READY, s.state[i]);
+			if (b->policy == BATCH_SRTF) {
+				s.order[i] = __select(out, head, s.order[i]);
+			}
+			s.state[i] = __select(in, zero + BATCH_RUNNING, s.state[i]);
+		}
+
+		/* The lanes where all processes exited are done at this tick */
+		{
+			lanes_t done = live & (b->nr_exited == (int)n);
+
+			b->makespan = __select(done, now, b->makespan);
+			live &= ~done;
+		}
+
+		/* Run the current for a tick, and drop the ones exited in all lanes */
+		for (unsigned int a = 0; a < nr_active; a++) {
+			unsigned int i = active[a];
+			lanes_t running = live & (s.state[i] == BATCH_RUNNING);
+			lanes_t alive = live & (s.state[i] != BATCH_EXITED);
+
+			s.first_run[i] = __select(running & (s.first_run[i] < 0), now, s.first_run[i]);
+			s.age[i] -= running;
+
+			if (__any(&alive)) active[nr_left++] = i;
+		}
+		nr_active = nr_left;
+	}
+
+	free(s.state);
+	free(s.age);
+	free(s.order);
+	free(s.epoch);
+	free(s.first_run);
+	free(forks);
+	free(active);
+	return 0;
+}
@@ -0,0 +1,82 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+/***********************************************************************
+ * Batch simulation
+ *
+ * DESCRIPTION
+ *   Simulate up to BATCH_LANES variants of the same scenario in lock-step.
+ *   The variants differ only in the start, lifespan, and priority of the
+ *   processes, and each variant occupies a lane of the vectors. The state
+ *   of the processes is kept as a structure of arrays, one vector per
+ *   property per process, and a tick is simulated for all the lanes at once
+ *   with masked updates that the compiler turns into SIMD instructions.
+ *
+ *   The batch covers CPU-bound processes on a single nominal CPU under the
+ *   policies below, which are the same as the ones in pa2.c. The framework
+ *   simulates the lanes one by one for the other scenarios.
+ */
+#define BATCH_LANES	16
+
+/**
+ * Every tick visits the processes forked and not exited yet, so the lanes
+ * fall behind simulating the variants one by one when many processes queue
+ * up. The framework simulates the scenarios with more processes one by one.
+ */
+#define BATCH_MAX_PROCESSES	128
+
+typedef int lanes_t __attribute__((vector_size(BATCH_LANES * sizeof(int))));
+
+enum batch_policy {
+	BATCH_FIFO,		/* The first ready, until it exits */
+	BATCH_SJF,		/* The shortest ready, until it exits */
+	BATCH_SRTF,		/* The shortest remaining, preempting the current */
+	BATCH_RR,		/* The first ready, putting back the current every tick */
+	BATCH_PRIO,		/* The most important ready, with aging */
+};
+
+struct batch {
+	enum batch_policy policy;
+	unsigned int aging_step;
+	unsigned int aging_period;
+
+	unsigned int nr_lanes;		/* # of lanes in use */
+	unsigned int nr_processes;	/* # of processes in each lane */
+
+	/* Properties of the processes in the order of the fork queue */
+	lanes_t *start;
+	lanes_t *lifespan;
+	lanes_t *prio;
+
+	/* Outcome of each lane */
+	lanes_t makespan;
+	lanes_t nr_exited;
+	lanes_t response;			/* Sum of the ticks to the first run */
+	lanes_t turnaround;			/* Sum of the ticks from fork to exit */
+};
+
+/***********************************************************************
+ * batch_simulate()
+ *
+ * DESCRIPTION
+ *   Simulate the lanes of @batch until all the processes in the lanes exit,
+ *   and fill in the outcome. Return 0 on success.
+ */
+int batch_simulate(struct batch *batch);
+
+#endif
@@ -0,0 +1,60 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __CPU_H__
+#define __CPU_H__
+
+struct process;
+
+/**
+ * Processors in the system.
+ */
+struct cpu {
+	unsigned int id;		/* CPU ID */
+
+	unsigned int capacity;	/* Speed of the CPU relative to the nominal one,
+							   in percent. A process running on this CPU
+							   ages by @capacity / CAPACITY_SCALE per tick */
+
+	unsigned int core;		/* The core that this CPU belongs to. CPUs on the
+							   same core are SMT siblings sharing the core */
+
+	struct process *current;
+							/* The process running on this CPU. The framework
+							   points @current to this before calling back
+							   the scheduler on behalf of this CPU */
+
+	/* DO NOT ACCESS FOLLOWING VARIABLES */
+	unsigned int __busy_ticks;	/* # of ticks this CPU ran a process */
+	unsigned int __migrations;	/* # of processes migrated to this CPU */
+	unsigned int __smt_ticks;	/* # of busy ticks shared with siblings */
+	unsigned int __spin_ticks;	/* # of busy ticks spent spinning */
+};
+
+/**
+ * The system has one nominal CPU unless the process description file
+ * declares CPUs with the 'cpu' or 'topology' property. The framework keeps
+ * them in struct cpu cpus[MAX_NR_CPUS] in sched.c.
+ */
+#define MAX_NR_CPUS		32
+#define CAPACITY_SCALE	100
+
+/**
+ * A CPU does @capacity * (SMT throughput in percent) work in a tick, and
+ * a process ages by one for every WORK_PER_AGE work done.
+ */
+#define WORK_PER_AGE	(CAPACITY_SCALE * CAPACITY_SCALE)
+
+#endif
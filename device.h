@@ -0,0 +1,59 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+/**
+ * The order in which a device serves the I/O requests queued on it
+ */
+enum io_discipline {
+	IO_FIFO,		/* In the order of arrival */
+	IO_SJF,			/* The shortest request first */
+	IO_PRIO,		/* The request of the highest priority process first */
+};
+
+/**
+ * I/O devices in the system. A process issuing an I/O request leaves the CPU
+ * and sleeps until the device completes the request. A device serves up to
+ * @parallelism requests at a time, and queues the others in @queue.
+ */
+struct device {
+	unsigned int id;			/* Device ID */
+	char name[32];				/* Name of the device */
+	enum io_discipline discipline;
+	unsigned int parallelism;	/* # of requests served at a time */
+
+	struct list_head queue;		/* Requests waiting to be served */
+	unsigned int nr_serving;	/* # of requests being served */
+
+	/* DO NOT ACCESS FOLLOWING VARIABLES */
+	unsigned int __nr_requests;	/* # of requests completed */
+	unsigned int __busy_since;	/* When the device started serving */
+	unsigned int __busy_ticks;	/* # of ticks serving any request */
+	unsigned long long __service_ticks;
+								/* Sum of ticks serving requests */
+	unsigned long long __wait_ticks;
+								/* Sum of ticks requests waited in @queue */
+};
+
+/**
+ * The system has the default device 'disk', which serves one request at
+ * a time in FIFO order. Up to MAX_NR_DEVICES devices including it can be
+ * declared with the 'device' property.
+ */
+#define MAX_NR_DEVICES	16
+
+#endif
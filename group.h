@@ -0,0 +1,77 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __GROUP_H__
+#define __GROUP_H__
+
+struct group;
+struct bandwidth;
+
+/**
+ * Entity that a fair scheduler allocates the CPU to. Both processes and
+ * groups are scheduling entities.
+ */
+struct sched_entity {
+	unsigned long long vruntime;	/* Virtual runtime. It increases inversely
+									   proportional to @weight while running */
+	unsigned int weight;	/* Share of the CPU among its siblings */
+	unsigned long long seq;	/* Enqueue order to break ties in @vruntime */
+	unsigned int epoch;		/* Aging epoch when the priority schedulers
+							   queued this entity */
+
+	struct group *parent;	/* The group whose runqueue holds this entity */
+	struct group *my_q;		/* The group that this entity represents.
+							   NULL if this entity is a process */
+
+	struct heap_node run_node;
+							/* heap node for the runqueue of @parent */
+};
+
+/**
+ * Process groups in the system. Groups form a hierarchy under the root group,
+ * and each group gets the CPU in proportion to its @shares among its siblings.
+ */
+struct group {
+	unsigned int id;		/* Group ID. The root group is 0 */
+	char name[32];			/* Name of the group */
+	unsigned int shares;	/* Weight of the group among its siblings */
+	struct group *parent;	/* Parent group. NULL for the root group */
+
+	struct sched_entity se;	/* Scheduling entity of this group in @parent */
+	struct heap runqueue;	/* Entities in this group ready to run */
+	unsigned long long min_vruntime;
+							/* Monotonic lower bound of @vruntime of the
+							   entities in @runqueue */
+	unsigned int nr_queued;	/* # of entities in @runqueue */
+
+	/* DO NOT ACCESS FOLLOWING VARIABLES */
+	struct bandwidth *__bandwidth;	/* CPU bandwidth limit of the group */
+	unsigned int __nr_processes;	/* # of processes forked in this group */
+	unsigned int __nr_exited;		/* # of processes exited in this group */
+	unsigned int __busy_ticks;		/* CPU ticks used by the processes */
+	unsigned int __nr_responses;	/* # of exited processes that have run */
+	unsigned long long __response;	/* Sum of the ticks to the first run */
+	unsigned long long __turnaround;/* Sum of the ticks from fork to exit */
+};
+
+/**
+ * The system has the root group, and up to MAX_NR_GROUPS groups including the
+ * root group can be declared with the 'group' property. The framework keeps
+ * them in struct group groups[MAX_NR_GROUPS] in sched.c.
+ */
+#define MAX_NR_GROUPS	32
+#define DEFAULT_SHARES	1024
+
+#endif
@@ -0,0 +1,122 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "types.h"
+#include "list_head.h"
+#include "heap.h"
+
+static inline void __heap_set(struct heap *heap, unsigned int i, struct heap_node *node)
+{
+	heap->nodes[i] = node;
+	node->index = i;
+}
+
+static void __heap_sift_up(struct heap *heap, unsigned int i)
+{
+	struct heap_node *node = heap->nodes[i];
+
+	while (i > 0) {
+		unsigned int parent = (i - 1) / 2;
+		if (!heap->less(node, heap->nodes[parent])) break;
+
+		__heap_set(heap, i, heap->nodes[parent]);
+		i = parent;
+	}
+	__heap_set(heap, i, node);
+}
+
+static void __heap_sift_down(struct heap *heap, unsigned int i)
+{
+	struct heap_node *node = heap->nodes[i];
+
+	while (true) {
+		unsigned int child = i * 2 + 1;
+		if (child >= heap->nr_nodes) break;
+
+		if (child + 1 < heap->nr_nodes &&
+				heap->less(heap->nodes[child + 1], heap->nodes[child])) {
+			child++;
+		}
+		if (!heap->less(heap->nodes[child], node)) break;
+
+		__heap_set(heap, i, heap->nodes[child]);
+		i = child;
+	}
+	__heap_set(heap, i, node);
+}
+
+void heap_push(struct heap *heap, struct heap_node *node)
+{
+	assert(!heap_queued(node));
+
+	if (heap->nr_nodes == heap->max_nodes) {
+		heap->max_nodes = heap->max_nodes ? heap->max_nodes * 2 : 16;
+		heap->nodes = realloc(heap->nodes, sizeof(*heap->nodes) * heap->max_nodes);
+		assert(heap->nodes);
+	}
+
+	__heap_set(heap, heap->nr_nodes++, node);
+	__heap_sift_up(heap, node->index);
+}
+
+struct heap_node *heap_pop(struct heap *heap)
+{
+	struct heap_node *top = heap_peek(heap);
+
+	if (top) heap_remove(heap, top);
+	return top;
+}
+
+void heap_remove(struct heap *heap, struct heap_node *node)
+{
+	unsigned int i = node->index;
+	struct heap_node *last;
+
+	assert(heap_queued(node) && heap->nodes[i] == node);
+
+	last = heap->nodes[--heap->nr_nodes];
+	node->index = -1;
+	if (last == node) return;
+
+	/* Fill the hole with the last node, and move it up or down */
+	__heap_set(heap, i, last);
+	heap_update(heap, last);
+}
+
+void heap_update(struct heap *heap, struct heap_node *node)
+{
+	unsigned int i = node->index;
+
+	assert(heap_queued(node));
+
+	if (i > 0 && heap->less(node, heap->nodes[(i - 1) / 2])) {
+		__heap_sift_up(heap, i);
+	} else {
+		__heap_sift_down(heap, i);
+	}
+}
+
+void heap_release(struct heap *heap)
+{
+	for (unsigned int i = 0; i < heap->nr_nodes; i++) {
+		heap->nodes[i]->index = -1;
+	}
+	free(heap->nodes);
+	heap->nodes = NULL;
+	heap->nr_nodes = heap->max_nodes = 0;
+}
@@ -0,0 +1,79 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+/***********************************************************************
+ * Binary min-heap
+ *
+ * DESCRIPTION
+ *   Like the list head, a heap node is embedded in the structure to keep
+ *   in the heap, and the structure is retrieved with heap_entry(). The heap
+ *   is ordered by @less() given to INIT_HEAP(), and the node at the top is
+ *   the least one. Pushing, popping, and removing a node take O(log n).
+ *   When the key of a queued node is changed, call heap_update() to
+ *   restore the order.
+ */
+struct heap_node {
+	int index;		/* Position in the heap. -1 if not in a heap */
+};
+
+struct heap {
+	struct heap_node **nodes;
+	unsigned int nr_nodes;
+	unsigned int max_nodes;
+
+	bool (*less)(struct heap_node *, struct heap_node *);
+};
+
+#define heap_entry(ptr, type, member) container_of(ptr, type, member)
+
+static inline void INIT_HEAP_NODE(struct heap_node *node)
+{
+	node->index = -1;
+}
+
+static inline void INIT_HEAP(struct heap *heap,
+		bool (*less)(struct heap_node *, struct heap_node *))
+{
+	heap->nodes = NULL;
+	heap->nr_nodes = 0;
+	heap->max_nodes = 0;
+	heap->less = less;
+}
+
+static inline bool heap_empty(const struct heap *heap)
+{
+	return heap->nr_nodes == 0;
+}
+
+static inline bool heap_queued(const struct heap_node *node)
+{
+	return node->index >= 0;
+}
+
+static inline struct heap_node *heap_peek(const struct heap *heap)
+{
+	return heap->nr_nodes ? heap->nodes[0] : NULL;
+}
+
+void heap_push(struct heap *heap, struct heap_node *node);
+struct heap_node *heap_pop(struct heap *heap);
+void heap_remove(struct heap *heap, struct heap_node *node);
+void heap_update(struct heap *heap, struct heap_node *node);
+void heap_release(struct heap *heap);
+
+#endif
@@ -21,10 +21,13 @@
 
 #include "types.h"
 #include "list_head.h"
+#include "heap.h"
+#include "timer.h"
 
 /**
  * The process which is currently running
  */
+#include "group.h"
 #include "process.h"
 extern struct process *current;
 
@@ -41,6 +44,13 @@ extern struct list_head readyqueue;
 extern struct resource resources[NR_RESOURCES];
 
 
+/**
+ * Process groups in the system. groups[0] is the root group.
+ */
+extern struct group groups[MAX_NR_GROUPS];
+extern unsigned int nr_groups;
+
+
 /**
  * Monotonically increasing ticks
  */
@@ -53,6 +63,14 @@ extern unsigned int ticks;
 extern bool quiet;
 
 
+/**
+ * Priority aging. A process waiting for the CPU gains @aging_step priority
+ * every @aging_period ticks. No aging if @aging_period is 0.
+ */
+extern unsigned int aging_step;
+extern unsigned int aging_period;
+
+
 /***********************************************************************
  * Default FCFS resource acquision function
  *
@@ -126,14 +144,11 @@ void fcfs_release(int resource_id)
 		 */
 		list_del_init(&waiter->list);
 
-		/* Update the process status */
-		waiter->status = PROCESS_READY;
-
 		/**
-		 * Put the waiter process into ready queue. The framework will
-		 * do the rest.
+		 * Put the waiter process into ready queue, which also updates the
+		 * process status. The framework will do the rest.
 		 */
-		list_add_tail(&waiter->list, &readyqueue);
+		wake_up_process(waiter);
 	}
 }
 
@@ -245,7 +260,7 @@ skip:
 	if (!list_empty(&readyqueue)) {
 		current = list_first_entry(&readyqueue, struct process, list);
 		list_for_each_entry(next, &readyqueue, list) {
-			if (current->lifespan > next->lifespan) current = next;
+			if (current->burst > next->burst) current = next;
 		}
 		list_del_init(&current->list);
 		return current;
@@ -288,7 +303,7 @@ static struct process *srtf_schedule(void)
 	if (!list_empty(&readyqueue)) {  //readyqueue   
 		init = list_first_entry(&readyqueue, struct process, list);
 		list_for_each_entry(next, &readyqueue, list) {
-			if (init->lifespan - init->age > next->lifespan - next->age) init = next;
+			if (init->burst - init->age > next->burst - next->age) init = next;
 		}
 		if (!current || current->status == PROCESS_WAIT) {   // current   (readyqueue  )
 			list_del_init(&init->list);
@@ -296,7 +311,7 @@ static struct process *srtf_schedule(void)
 		}
 		else {    // current   (readyqueue  )
 			if (current->age < current->lifespan) { // current  ؾ Ѵٸ 
-				if (init->lifespan - init->age < current->lifespan - current->age) {   //init  ª init list ϰ current list ߰ϰ initȯ
+				if (init->burst - init->age < current->burst - current->age) {   //init  ª init list ϰ current list ߰ϰ initȯ
 					list_del_init(&init->list);
 					list_add(&current->list, &readyqueue);
 					return init;
@@ -311,7 +326,7 @@ static struct process *srtf_schedule(void)
 			}
 		}
 	}
-	if (current != NULL || current->status == PROCESS_RUNNING) { // readyqueue   current ִٸ current   ؾϸ current,  ص ȴٸ NULL ȯ
+	if (current != NULL && current->status == PROCESS_RUNNING) { // readyqueue   current ִٸ current   ؾϸ current,  ص ȴٸ NULL ȯ
 		if (current->age < current->lifespan)
 			return current;
 	}
@@ -383,14 +398,67 @@ struct scheduler rr_scheduler = {
 
 /***********************************************************************
  * Priority scheduler
+ *
+ * Processes ready to run are kept in a heap ordered by their priorities,
+ * and then by the order they became ready. The heap is shared with the
+ * priority scheduler with PIP.
+ *
+ * With aging, a process queued at epoch e = ticks / aging_period gains
+ * aging_step * (now - e) priority by the epoch now. As every queued
+ * process gains the same aging_step * now, the heap is ordered by
+ * prio - aging_step * e instead, which never changes while queued. So the
+ * processes age in bulk without being touched, and the aging resets when
+ * the process is queued again after running.
  ***********************************************************************/
+static struct heap prio_heap;
+
+static unsigned long long prio_seq = 0;
+
+static inline long long prio_key(struct process *p)
+{
+	return (long long)p->prio - (long long)aging_step * p->se.epoch;
+}
+
+static bool prio_less(struct heap_node *a, struct heap_node *b)
+{
+	struct process *pa = heap_entry(a, struct process, se.run_node);
+	struct process *pb = heap_entry(b, struct process, se.run_node);
+
+	if (prio_key(pa) != prio_key(pb)) return prio_key(pa) > prio_key(pb);
+	return pa->se.seq < pb->se.seq;
+}
+
 static int prio_initialize(void)
 {
+	INIT_HEAP(&prio_heap, prio_less);
 	return 0;
 }
 
 static void prio_finalize(void)
 {
+	/* Hand the processes in the heap over to the ready queue */
+	for (unsigned int i = 0; i < prio_heap.nr_nodes; i++) {
+		list_add_tail(&heap_entry(prio_heap.nodes[i], struct process, se.run_node)->list,
+				&readyqueue);
+	}
+	heap_release(&prio_heap);
+}
+
+static void prio_enqueue(struct process *p)
+{
+	p->se.seq = prio_seq++;
+	p->se.epoch = aging_period ? ticks / aging_period : 0;
+	heap_push(&prio_heap, &p->se.run_node);
+}
+
+/**
+ * Move @p to the new position for its new priority
+ */
+static void prio_changed(struct process *p, unsigned int old_prio)
+{
+	if (heap_queued(&p->se.run_node)) {
+		heap_update(&prio_heap, &p->se.run_node);
+	}
 }
 
 bool prio_acquire(int resource_id)
@@ -430,41 +498,29 @@ void prio_release(int resource_id)
 
 		list_del_init(&waiter->list);
 
-		waiter->status = PROCESS_READY;
-
-		list_add_tail(&waiter->list, &readyqueue);
+		wake_up_process(waiter);
 	}
 }
 
 
 
 static struct process *prio_schedule(void) {
+	struct process *p, *tmp;
 
-
-	struct process *next = NULL;
-
-	if (!current || current->status == PROCESS_WAIT) {
-		goto skip;
+	/* Forked and woken-up processes are put into the ready queue */
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		prio_enqueue(p);
 	}
 
-	if (current->age < current->lifespan) {
-		list_add_tail(&current->list, &readyqueue);
+	if (current && current->status != PROCESS_WAIT &&
+			current->age < current->lifespan) {
+		prio_enqueue(current);
 	}
 
-skip:
-
-	if (!list_empty(&readyqueue)) {
-		next = list_first_entry(&readyqueue, struct process, list);
-		list_for_each_entry(current, &readyqueue, list) {
-			if (next->prio < current->prio) next = current;
-		}
-
-		list_del_init(&next->list);
-	}
-
-	return next;
-
+	if (heap_empty(&prio_heap)) return NULL;
 
+	return heap_entry(heap_pop(&prio_heap), struct process, se.run_node);
 }
 
 struct scheduler prio_scheduler = {
@@ -474,6 +530,7 @@ struct scheduler prio_scheduler = {
 	.initialize = prio_initialize,
 	.finalize = prio_finalize,
 	.schedule = prio_schedule,
+	.prio_changed = prio_changed,
 	/**
 	 * Implement your own acqure/release function to make priority
 	 * scheduler correct.
@@ -485,15 +542,6 @@ struct scheduler prio_scheduler = {
 /***********************************************************************
  * Priority scheduler with priority inheritance protocol
  ***********************************************************************/
-static int pip_initialize(void)
-{
-	return 0;
-}
-
-static void pip_finalize(void)
-{
-}
-
 bool pip_acquire(int resource_id) 
 {
 	struct resource *r = resources + resource_id;
@@ -504,7 +552,10 @@ bool pip_acquire(int resource_id)
 	}
 
 	if (r->owner->prio < current->prio) {
+		unsigned int old_prio = r->owner->prio;
+
 		r->owner->prio = current->prio;
+		prio_changed(r->owner, old_prio);
 	}
 
 	current->status = PROCESS_WAIT;
@@ -538,54 +589,152 @@ void pip_release(int resource_id)
 
 		list_del_init(&waiter->list);
 
-		waiter->status = PROCESS_READY;
-
-		list_add_tail(&waiter->list, &readyqueue);
+		wake_up_process(waiter);
 	}
 
 
 }
 
 
-static struct process *pip_schedule(void) {
-	struct process *next = NULL;
+struct scheduler pip_scheduler = {
+	.name = "Priority + Priority Inheritance Protocol",
+	.acquire = pip_acquire,
+	.release = pip_release,
+	.initialize = prio_initialize,
+	.finalize = prio_finalize,
+	.schedule = prio_schedule,
+	.prio_changed = prio_changed,
 
-	if (!current || current->status == PROCESS_WAIT) {
-		goto skip;
-	}
+	/**
+	 * Implement your own acqure/release function too to make priority
+	 * scheduler correct.
+	 */
+	/* It goes without saying to implement your own pip_schedule() */
+};
 
-	if (current->age < current->lifespan) {
-		list_add_tail(&current->list, &readyqueue);
+
+
+/***********************************************************************
+ * Hierarchical fair scheduler
+ *
+ * Each group keeps the entities (processes and child groups) ready to run in
+ * its runqueue, which is a heap ordered by the virtual runtime. Running
+ * for a tick increases the vruntime of the process and its ancestor groups
+ * inversely proportional to their weights. To pick the next, walk down from
+ * the root group along the entities with the least vruntime.
+ ***********************************************************************/
+#define FAIR_SCALE	(1024ULL * 1024)
+
+static unsigned long long fair_seq = 0;
+
+static bool fair_less(struct heap_node *a, struct heap_node *b)
+{
+	struct sched_entity *sa = heap_entry(a, struct sched_entity, run_node);
+	struct sched_entity *sb = heap_entry(b, struct sched_entity, run_node);
+
+	if (sa->vruntime != sb->vruntime) return sa->vruntime < sb->vruntime;
+	return sa->seq < sb->seq;
+}
+
+static int fair_initialize(void)
+{
+	for (int i = 0; i < nr_groups; i++) {
+		INIT_HEAP(&groups[i].runqueue, fair_less);
+		groups[i].nr_queued = 0;
 	}
+	return 0;
+}
 
-skip:
+static void fair_finalize(void)
+{
+	/* Hand the processes in the runqueues over to the ready queue */
+	for (int i = 0; i < nr_groups; i++) {
+		struct heap *rq = &groups[i].runqueue;
 
-	if (!list_empty(&readyqueue)) {
-		next = list_first_entry(&readyqueue, struct process, list);
-		list_for_each_entry(current, &readyqueue, list) {
-			if (next->prio < current->prio) next = current;
+		for (unsigned int j = 0; j < rq->nr_nodes; j++) {
+			struct sched_entity *se =
+					heap_entry(rq->nodes[j], struct sched_entity, run_node);
+			if (se->my_q) continue;
+
+			list_add_tail(&container_of(se, struct process, se)->list, &readyqueue);
 		}
-		list_del_init(&next->list);
+		heap_release(rq);
 	}
+}
 
-	return next;
+static void fair_enqueue(struct sched_entity *se)
+{
+	struct group *g = se->parent;
+
+	/* Do not let an entity woken up after a long sleep monopolize the CPU */
+	if (se->vruntime < g->min_vruntime) se->vruntime = g->min_vruntime;
 
+	se->seq = fair_seq++;
+	heap_push(&g->runqueue, &se->run_node);
 
+	/* The group becomes ready to run with its first entity */
+	if (g->nr_queued++ == 0 && g->parent) fair_enqueue(&g->se);
 }
 
+static void fair_dequeue(struct sched_entity *se)
+{
+	struct group *g = se->parent;
 
+	heap_remove(&g->runqueue, &se->run_node);
+	if (se->vruntime > g->min_vruntime) g->min_vruntime = se->vruntime;
 
-struct scheduler pip_scheduler = {
-	.name = "Priority + Priority Inheritance Protocol",
-	.acquire = pip_acquire,
-	.release = pip_release,
-	.initialize = pip_initialize,
-	.finalize = pip_finalize,
-	.schedule = pip_schedule,
+	/* Nothing to run in the group anymore */
+	if (--g->nr_queued == 0 && g->parent) fair_dequeue(&g->se);
+}
 
-	/**
-	 * Implement your own acqure/release function too to make priority
-	 * scheduler correct.
-	 */
-	/* It goes without saying to implement your own pip_schedule() */
+static void fair_charge(struct sched_entity *se)
+{
+	for (; se->parent; se = &se->parent->se) {
+		se->vruntime += FAIR_SCALE / se->weight;
+		if (heap_queued(&se->run_node)) {
+			heap_update(&se->parent->runqueue, &se->run_node);
+		}
+	}
+}
+
+static struct process *fair_schedule(void)
+{
+	struct process *p, *tmp;
+	struct sched_entity *se;
+	struct group *g = groups;
+
+	/* Charge the current for the tick, and put it back if it is still ready */
+	if (current) {
+		fair_charge(&current->se);
+
+		if (current->status != PROCESS_WAIT && current->age < current->lifespan) {
+			fair_enqueue(&current->se);
+		}
+	}
+
+	/* Forked and woken-up processes are put into the ready queue */
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		fair_enqueue(&p->se);
+	}
+
+	if (!g->nr_queued) return NULL;
+
+	do {
+		se = heap_entry(heap_peek(&g->runqueue), struct sched_entity, run_node);
+		g = se->my_q;
+	} while (g);
+
+	fair_dequeue(se);
+
+	return container_of(se, struct process, se);
+}
+
+struct scheduler fair_scheduler = {
+	.name = "Hierarchical Fair",
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.initialize = fair_initialize,
+	.finalize = fair_finalize,
+	.schedule = fair_schedule,
 };
@@ -0,0 +1,39 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __PROBE_H__
+#define __PROBE_H__
+
+/***********************************************************************
+ * Static tracepoints
+ *
+ * DESCRIPTION
+ *   trace_sched() marks a USDT probe sched:@probe in the binary, which
+ *   bpftrace or perf can attach to (e.g., usdt:./sched:sched:acquire).
+ *   Each probe passes the tick, pid, priority, and resource id as its four
+ *   arguments, and -1 for what does not apply. A probe costs a nop unless
+ *   attached. The Makefile defines HAVE_SYS_SDT_H when <sys/sdt.h> is
+ *   available, and the probes compile to nothing otherwise.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define trace_sched(probe, pid, prio, resource_id) \
+	DTRACE_PROBE4(sched, probe, ticks, pid, prio, resource_id)
+#else
+#define trace_sched(probe, pid, prio, resource_id) do { } while (0)
+#endif
+
+#endif
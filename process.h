@@ -17,14 +17,48 @@
 #define __PROCESS_H__
 
 struct list_head;
+struct group;
+struct bandwidth;
+struct behavior;
 
 enum process_status {
 	PROCESS_READY,		/* Process is ready to run */
 	PROCESS_RUNNING,	/* The process is now running */
 	PROCESS_WAIT,		/* The process is waiting for some resource */
 	PROCESS_EXIT,		/* The process is exited */
+	PROCESS_THROTTLED,	/* The process used up its CPU bandwidth */
 };
 
+/**
+ * Scheduling classes. The framework picks the next process from the rt class
+ * first, then the fair class, and finally the idle class.
+ */
+enum sched_class_id {
+	SCHED_CLASS_RT,		/* Real-time processes served in the order of priority */
+	SCHED_CLASS_FAIR,	/* Processes served by the selected scheduler */
+	SCHED_CLASS_IDLE,	/* Processes to run only when nothing else is ready */
+	NR_SCHED_CLASSES,
+};
+
+/**
+ * Without clairvoyance, @lifespan of a process reads UNKNOWN_LIFESPAN until
+ * the process completes, and @burst is predicted from the previous runs of
+ * the same program. The framework keeps @burst larger than @age while the
+ * process is alive.
+ */
+#define UNKNOWN_LIFESPAN	((unsigned int)-1)
+
+/**
+ * Real-time processes are with priority 0 to MAX_RT_PRIO - 1
+ */
+#define MAX_RT_PRIO	100
+
+/**
+ * A process may run multiple threads, each of which is described by its own
+ * struct process with the same @pid and is scheduled separately. The threads
+ * of a process share the resources the process holds, and are accounted
+ * together as the process.
+ */
 struct process {
 	unsigned int pid;		/* Process ID */
 
@@ -34,6 +68,8 @@ struct process {
 	unsigned int age;		/* # of ticks since the process was forked */
 	unsigned int lifespan;	/* The lifespan of the process. The process will
 							   be exited with age == lifespan */
+	unsigned int burst;		/* Expected lifespan of the process. The same as
+							   @lifespan unless the lifespan is hidden */
 
 	unsigned int prio;		/* Currently effective priority of the process.
 							   0 by default, and the larger, the more important
@@ -46,6 +82,17 @@ struct process {
 	 */
 	unsigned int prio_orig;	/* The original priority of the process */
 
+	enum sched_class_id sched_class;
+							/* The scheduling class of the process. The
+							   scheduler only sees processes of the fair
+							   class; the framework manages the others */
+
+	struct group *group;	/* The group that the process belongs to */
+
+	struct sched_entity se;	/* Scheduling entity for the fair scheduler. The
+							   priority schedulers keep processes in their
+							   heap through this as well */
+
 
 	/* DO NOT ACCESS FOLLOWING VARIABLES */
 	unsigned int __starts_at;	/* When to fork the process */
@@ -55,6 +102,67 @@ struct process {
 
 	struct list_head __resources_holding;
 								/* Resources that the process is currently holding */
+
+	struct list_head __io_to_issue;
+								/* Schedule to issue I/O requests and sleep */
+
+	struct list_head __prio_to_set;
+								/* Schedule to change the priority */
+
+	struct list_head __barriers_to_reach;
+								/* Schedule to wait at barriers */
+
+	struct list_head __messages_to_pass;
+								/* Schedule to send and receive messages */
+
+	unsigned int __nr_predecessors;
+								/* # of processes to exit before forking this */
+	struct list_head __successors;
+								/* Processes to fork after this exits */
+	unsigned int __finish_at;	/* The earliest possible tick to exit with
+								   unlimited CPUs */
+
+	struct process *__leader;	/* The main thread of the process. Itself if
+								   this is the main thread */
+	unsigned int __tid;			/* Thread ID in the process. 0 for the main */
+	struct list_head __threads;	/* Threads other than the main one. Valid only
+								   in the main thread */
+	struct list_head __sibling;	/* list head for @__threads of the main */
+	unsigned int __nr_threads;	/* # of threads alive in the process. Valid
+								   only in the main thread */
+
+	unsigned int __progress;	/* Work done toward the next age. The process
+								   ages when it reaches WORK_PER_AGE */
+
+	unsigned int __arrived_at;	/* When the process was due to fork */
+	unsigned int __forked_at;	/* When the process was forked */
+	bool __has_run;				/* Whether the process has been on a CPU */
+	unsigned int __first_run_at;
+								/* When the process was on a CPU first */
+	unsigned int __busy_ticks;	/* # of ticks the process was on a CPU */
+
+	struct bandwidth *__bandwidth;
+								/* CPU bandwidth limit of the process */
+	unsigned int __throttled_at;
+								/* When the process was throttled last */
+	unsigned int __throttled_ticks;
+								/* # of ticks the process was throttled */
+
+	unsigned int __rt_prio;		/* Priority level that the process is queued at
+								   in the rt class */
+
+	struct timer __watchdog;	/* Fires when the process waits for too long */
+	unsigned int __waiting_since;
+								/* When the process started waiting */
+	int __blocked_on;			/* The resource that the process is blocked on.
+								   -1 if not blocked on any resource */
+
+	unsigned int __lifespan;	/* The real lifespan of the process */
+	unsigned int __program;		/* The program that the process runs */
+	struct behavior *__behavior;
+								/* Bytecode that the thread runs. NULL if it
+								   just runs for the lifespan */
+	unsigned int __predicted;	/* @burst predicted when the process was forked */
 };
 
 /**
@@ -62,4 +170,11 @@ struct process {
  */
 void dump_status(void);
 
+/**
+ * Support function to make @p ready to run. The framework puts @p into the
+ * ready queue if @p is in the fair class, or into the queue of its class
+ * otherwise. Use this function to wake up processes waiting for resources.
+ */
+void wake_up_process(struct process *p);
+
 #endif
@@ -19,6 +19,16 @@
 struct process;
 struct list_head;
 
+/**
+ * How a process waits for a resource held by others
+ */
+enum resource_type {
+	RESOURCE_SLEEP,		/* Sleep on @waitqueue until the resource is released */
+	RESOURCE_SPIN,		/* Spin on the CPU until the resource is released */
+	RESOURCE_ADAPTIVE,	/* Spin while the owner is running on another CPU,
+						   and sleep otherwise */
+};
+
 /**
  * Resources in the system.
  */
@@ -33,6 +43,21 @@ struct resource {
 	 * list head to list processes that are wanting for the resource
 	 */
 	struct list_head waitqueue;
+
+	/**
+	 * How processes wait for this resource. Spinning waiters are never put
+	 * into @waitqueue; they keep running on their CPUs and retry acquiring
+	 * the resource on every tick instead. Spinning is only possible with
+	 * multiple CPUs, so waiters always sleep on a single CPU.
+	 */
+	enum resource_type type;
+
+	/* DO NOT ACCESS FOLLOWING VARIABLES */
+	unsigned int __spin_ticks;	/* # of CPU ticks burned spinning on this */
+	unsigned int __nr_sleeps;	/* # of times processes slept on this */
+	unsigned int __nr_holders;	/* # of threads of @owner process holding this */
+	unsigned int __nr_waiters;	/* # of processes blocked on this */
+	bool __used;				/* Whether any process is to acquire this */
 };
 
 /**
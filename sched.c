@@ -18,17 +18,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "types.h"
 #include "list_head.h"
+#include "heap.h"
+#include "timer.h"
 
 #include "parser.h"
+#include "group.h"
 #include "process.h"
 #include "resource.h"
+#include "cpu.h"
+#include "bandwidth.h"
+#include "device.h"
+#include "probe.h"
+#include "batch.h"
 
 #include "sched.h"
 
@@ -52,6 +63,31 @@ unsigned int ticks = 0;
  */
 struct resource resources[NR_RESOURCES];
 
+/**
+ * Processors in the system. @cpus[0 .. @nr_cpus - 1] are valid.
+ */
+struct cpu cpus[MAX_NR_CPUS];
+unsigned int nr_cpus = 0;
+
+/**
+ * Process groups in the system. @groups[0] is the root group.
+ */
+struct group groups[MAX_NR_GROUPS];
+unsigned int nr_groups = 1;
+
+/**
+ * Throughput of a hardware thread in percent while its SMT sibling(s) are
+ * busy on the same core.
+ */
+unsigned int smt_rate = 60;
+
+/**
+ * Priority aging. A process waiting for the CPU gains @aging_step priority
+ * every @aging_period ticks. No aging if @aging_period is 0.
+ */
+unsigned int aging_step = 0;
+unsigned int aging_period = 0;
+
 /**
  * Following code is to maintain the simulator itself.
  */
@@ -62,15 +98,300 @@ struct resource_schedule {
 	struct list_head list;
 };
 
+struct prio_schedule {
+	unsigned int at;
+	unsigned int prio;
+	struct list_head list;
+};
+
+/**
+ * Barriers to synchronize processes. A barrier holds the arriving processes
+ * until @count processes have arrived, releases them all together, and then
+ * starts over for the next round.
+ */
+#define MAX_NR_BARRIERS	32
+
+struct barrier {
+	unsigned int count;			/* # of processes to arrive in a round */
+	unsigned int nr_arrived;	/* # of processes arrived in this round */
+	struct list_head waiters;	/* Arrivals waiting for the others */
+
+	unsigned int nr_rounds;		/* # of rounds completed */
+	unsigned int nr_waits;		/* # of arrivals that waited */
+	unsigned long long stall_ticks;
+								/* Sum of the ticks that arrivals waited */
+	unsigned int max_stall;		/* The longest wait for a straggler */
+};
+
+struct barrier_schedule {
+	unsigned int barrier_id;
+	unsigned int at;
+	unsigned int arrived_at;
+	struct process *process;
+	struct list_head list;
+};
+
+static struct barrier __barriers[MAX_NR_BARRIERS];
+
+/**
+ * Bounded channels to pass messages between processes. A sender waits in
+ * @senders while the channel is full, and a receiver in @receivers while it
+ * is empty. Thus, @receivers is empty unless @nr_messages is 0, and so is
+ * @senders unless the channel is full.
+ */
+#define MAX_NR_CHANNELS	32
+#define DEFAULT_CHANNEL_CAPACITY	1
+
+struct channel {
+	unsigned int capacity;		/* # of messages the channel can hold */
+	unsigned int nr_messages;	/* # of messages in the channel */
+	struct list_head senders;	/* Senders waiting for a room */
+	struct list_head receivers;	/* Receivers waiting for a message */
+
+	unsigned int nr_passed;		/* # of messages received */
+	unsigned int changed_at;	/* When @nr_messages changed last */
+	unsigned long long occupancy;
+								/* Sum of @nr_messages over the ticks */
+	unsigned long long send_ticks;
+								/* Sum of the ticks senders waited */
+	unsigned long long recv_ticks;
+								/* Sum of the ticks receivers waited */
+};
+
+struct message_schedule {
+	unsigned int channel_id;
+	unsigned int at;
+	bool send;
+	unsigned int queued_at;
+	struct process *process;
+	struct list_head list;
+};
+
+static struct channel __channels[MAX_NR_CHANNELS];
+
+struct io_request {
+	unsigned int at;
+	unsigned int duration;
+	struct device *device;		/* NULL for sleeping */
+	struct process *process;
+	unsigned int queued_at;
+	struct timer timer;
+	struct list_head list;
+};
+
+/**
+ * Behavior of a thread compiled into bytecode from the 'do' block. Each
+ * instruction is a word with the opcode in the low 8 bits and the operand in
+ * the others, and I/O takes the device id in the following word. Whenever
+ * the thread finishes a compute, the framework runs the instructions up to
+ * the next compute; releases take effect right away, and acquisitions and
+ * I/O are scheduled at the age as the 'acquire' and 'io' properties are. So
+ * the memory and the time to load are proportional to the size of the
+ * program, not to how long it runs.
+ */
+enum behavior_op {
+	OP_COMPUTE,		/* Run for @operand ticks */
+	OP_ACQUIRE,		/* Acquire resource @operand */
+	OP_RELEASE,		/* Release resource @operand */
+	OP_SLEEP,		/* Sleep for @operand ticks */
+	OP_IO,			/* Issue I/O taking @operand ticks to the device in the next word */
+	OP_LOOP,		/* Run up to the matching OP_ENDLOOP @operand times */
+	OP_ENDLOOP,		/* Jump back by @operand words unless the loop is done */
+};
+
+#define BEHAVIOR_INSN(op, operand)	((unsigned int)(operand) << 8 | (op))
+#define BEHAVIOR_OP(insn)			((insn) & 0xff)
+#define BEHAVIOR_OPERAND(insn)		((insn) >> 8)
+#define MAX_BEHAVIOR_OPERAND		((1U << 24) - 1)
+#define MAX_LOOP_DEPTH				8
+
+/**
+ * Resources acquired by a behavior are held until released by the behavior
+ */
+#define HOLD_UNTIL_RELEASE		-1
+
+struct behavior {
+	unsigned int *code;
+	unsigned int nr_words;
+	unsigned int max_words;
+
+	unsigned int lifespan;		/* Total ticks of the computes */
+
+	unsigned int ip;			/* The instruction to run next */
+	unsigned int computing;		/* Ticks to run before the next instruction */
+	unsigned int nr_loops;
+	unsigned int loops[MAX_LOOP_DEPTH];
+								/* Iterations left in the loops running */
+};
+
 static LIST_HEAD(__forkqueue);
 
+/**
+ * Admission control at the fork time. A process due to fork is admitted
+ * while the system is under the limit. Otherwise, it is rejected, or held
+ * back in @queue until the system gets room. Shedding holds back up to
+ * @depth processes, and drops the least important one beyond it.
+ */
+enum admission_limit {
+	ADMIT_ALL,			/* Admit everything */
+	ADMIT_RUNNABLE,		/* Up to @value runnable processes */
+	ADMIT_RATE,			/* @value processes every @period ticks */
+	ADMIT_WAIT,			/* Up to @value ticks of predicted wait */
+};
+
+enum admission_action {
+	ADMIT_REJECT,
+	ADMIT_DEFER,
+	ADMIT_SHED,
+};
+
+static const char *__admission_limit_sz[] = {
+	"all",
+	"runnable",
+	"rate",
+	"wait",
+};
+
+static const char *__admission_action_sz[] = {
+	"reject",
+	"defer",
+	"shed",
+};
+
+static struct admission {
+	enum admission_limit limit;
+	unsigned int value;
+	unsigned int period;
+	enum admission_action action;
+	unsigned int depth;
+
+	unsigned long long tokens;	/* Token bucket in 1/@period tokens */
+	unsigned int refilled_at;
+	struct list_head queue;		/* Processes held back */
+	unsigned int nr_queued;
+
+	unsigned int nr_arrived;
+	unsigned int nr_admitted;
+	unsigned int nr_rejected;
+	unsigned int nr_shed;
+	unsigned long long wait_ticks;
+	unsigned int max_wait;
+	unsigned long long turnaround;
+								/* Sum of the ticks from arrival to exit */
+} __admission = {
+	.limit = ADMIT_ALL,
+	.queue = LIST_HEAD_INIT(__admission.queue),
+};
+
+/**
+ * Sum of the expected ticks for the forked threads to exit, which is to
+ * predict the waiting time of new arrivals
+ */
+static unsigned long long __backlog = 0;
+
+/**
+ * Dependencies between processes. A process declared to run after others
+ * waits in @__dependents until its predecessors exit. Each dependency is
+ * listed in @__dependencies while loading, and then in the successors list
+ * of the predecessor.
+ */
+struct dependency {
+	unsigned int pid;			/* Predecessor */
+	struct process *process;	/* Successor */
+	struct list_head list;
+};
+
+static LIST_HEAD(__dependents);
+static LIST_HEAD(__dependencies);
+static unsigned int __critical_path = 0;
+
+/**
+ * I/O devices declared in the process description file. __devices[0] is the
+ * default device. @__nr_sleeping counts the processes sleeping on I/O or
+ * timers.
+ */
+static struct device __devices[MAX_NR_DEVICES];
+static unsigned int __nr_devices = 1;
+static unsigned int __nr_sleeping = 0;
+
+static const char *__io_discipline_sz[] = {
+	"fifo",
+	"sjf",
+	"prio",
+};
+
+/**
+ * Scheduling classes consulted in the order of rt, fair, and idle. The fair
+ * class is the scheduler selected with the command line option, which manages
+ * @readyqueue. @nr_running counts the runnable processes of the class
+ * including the ones running on CPUs, so that empty classes are skipped
+ * without looking into their queues.
+ */
+struct sched_class {
+	const char *name;
+	unsigned int nr_running;
+
+	void (*enqueue)(struct process *p, bool head);
+	struct process *(*pick_next)(void);
+
+	unsigned int nr_processes;
+	unsigned int nr_exited;
+	unsigned long long response;
+	unsigned long long turnaround;
+};
+
+static struct sched_class __sched_classes[NR_SCHED_CLASSES];
+
+/**
+ * Queues for the rt class. Processes are queued at the list for their
+ * priorities, and @__rt_bitmap tells the non-empty lists.
+ */
+static struct list_head __rt_queues[MAX_RT_PRIO];
+static unsigned long long __rt_bitmap[(MAX_RT_PRIO + 63) / 64];
+
+/**
+ * Queue for the idle class
+ */
+static LIST_HEAD(__idlequeue);
+
+/**
+ * CPU bandwidth limits declared in the process description file, and the
+ * number of processes throttled by them
+ */
+static LIST_HEAD(__bandwidths);
+static unsigned int __nr_throttled = 0;
+
+/**
+ * CPUs sorted in the descending order of their capacities. Idle CPUs pick
+ * processes in this order so that the processes are placed onto the fastest
+ * CPUs available.
+ */
+static struct cpu *__cpus_by_capacity[MAX_NR_CPUS];
+
+/**
+ * Number of busy hardware threads on each core in the current tick
+ */
+static unsigned int __nr_busy_threads[MAX_NR_CPUS];
+
+/**
+ * True if some cores have more than one hardware thread
+ */
+static bool __smt = false;
+
 bool quiet = false;
 
+static const char * __resource_type_sz[] = {
+	"sleep",
+	"spin",
+	"adaptive",
+};
+
 static const char * __process_status_sz[] = {
 	"RDY",
 	"RUN",
 	"WAT",
 	"EXT",
+	"THR",
 };
 
 /**
@@ -82,19 +403,204 @@ extern struct scheduler srtf_scheduler;
 extern struct scheduler rr_scheduler;
 extern struct scheduler prio_scheduler;
 extern struct scheduler pip_scheduler;
+extern struct scheduler fair_scheduler;
 
 static struct scheduler *sched = &fifo_scheduler;
 
+static const struct {
+	const char *name;
+	struct scheduler *sched;
+} __schedulers[] = {
+	{ "fifo", &fifo_scheduler },
+	{ "sjf", &sjf_scheduler },
+	{ "srtf", &srtf_scheduler },
+	{ "rr", &rr_scheduler },
+	{ "prio", &prio_scheduler },
+	{ "pip", &pip_scheduler },
+	{ "fair", &fair_scheduler },
+};
+
+/**
+ * Online metrics over the monitoring window, and the rules to switch the
+ * scheduler based on them
+ */
+enum monitor_metric {
+	METRIC_RUNQUEUE,	/* Average # of processes waiting for CPUs */
+	METRIC_BLOCKED,		/* Percentage of busy CPU ticks that are blocked */
+	METRIC_RESPONSE,	/* Average response time of the processes that
+						   were on CPUs first in the window */
+	NR_METRICS,
+};
+
+static const char *__metric_sz[] = {
+	"runqueue",
+	"blocked",
+	"response",
+};
+
+/**
+ * Metrics exported to @file every @every ticks, as CSV rows, or in the
+ * Prometheus text format if @file ends with .prom. A .prom file holds only
+ * the latest sample as the textfile collector of the node exporter expects,
+ * and is replaced as a whole through @tmpfile so that readers never see it
+ * half written. The load averages are maintained in the fixed point as
+ * Linux does; every LOAD_FREQ ticks, they decay toward the number of
+ * processes that are runnable or blocked on resources and I/O.
+ */
+#define FSHIFT		11
+#define FIXED_1		(1 << FSHIFT)
+#define LOAD_FREQ	5
+#define EXP_1		1884	/* 1 / exp(5 / 60) in the fixed point */
+#define EXP_5		2014	/* 1 / exp(5 / 300) */
+#define EXP_15		2037	/* 1 / exp(5 / 900) */
+
+static struct {
+	const char *file;
+	FILE *fp;					/* The CSV file being appended */
+	bool prometheus;
+	char *tmpfile;				/* Where to write the next .prom file */
+	unsigned int every;
+
+	unsigned long avenrun[3];	/* 1, 5, and 15-tick load averages */
+
+	unsigned int sampled_at;
+	unsigned int busy_ticks;	/* CPU busy ticks by @sampled_at */
+	unsigned int nr_forks;		/* # of forks since @sampled_at */
+	unsigned int nr_exits;		/* # of exits since @sampled_at */
+} __export = {
+	.every = 10,
+};
+
+static unsigned int __nr_blocked = 0;	/* # of processes blocked on resources */
+static unsigned int __nr_io_waiting = 0;
+										/* # of processes waiting for I/O */
+
+static struct {
+	unsigned int window;	/* Length of the window. 0 if not monitoring */
+	unsigned long long runqueue;
+	unsigned int busy;
+	unsigned int blocked;
+	unsigned int nr_responses;
+	unsigned long long response;
+} __monitor;
+
+struct switch_rule {
+	struct scheduler *sched;	/* Scheduler to switch to */
+	enum monitor_metric metric;
+	char op[3];
+	double value;
+
+	struct list_head list;
+};
+
+static LIST_HEAD(__switch_rules);
+
+struct switch_point {
+	unsigned int at;
+	struct scheduler *sched;
+	struct switch_rule *rule;
+	double value;
+
+	struct list_head list;
+};
+
+static LIST_HEAD(__switch_points);
+
+/**
+ * Programs that processes run. Without clairvoyance, the lifespan of a process
+ * is predicted from the previous runs of the same program. Processes that do
+ * not declare their program run the anonymous program, __programs[0].
+ */
+#define MAX_NR_PROGRAMS	32
+#define HISTOGRAM_BINS	64
+
+struct program {
+	char name[32];
+	unsigned int nr_runs;		/* # of the runs completed */
+	double average;				/* Exponential average of the lifespans */
+	unsigned int histogram[HISTOGRAM_BINS];
+								/* # of the runs by lifespan. The last bin
+								   counts the runs longer than the others */
+	unsigned int longest;		/* The longest lifespan so far */
+};
+
+static struct program __programs[MAX_NR_PROGRAMS];
+static unsigned int __nr_programs = 1;
+
+enum predictor {
+	PREDICTOR_NONE,			/* Clairvoyant. @burst is the real lifespan */
+	PREDICTOR_AVERAGE,		/* Exponential average of the previous runs */
+	PREDICTOR_QUANTILE,		/* Quantile of the previous runs */
+};
+
+static enum predictor __predictor = PREDICTOR_NONE;
+static unsigned int __quantile = 50;	/* In percent */
+
+/**
+ * Outcome of a simulation to compare the predictor with the clairvoyance
+ */
+struct outcome {
+	unsigned int makespan;
+	unsigned int nr_exited;
+	unsigned long long response;
+	unsigned long long turnaround;
+};
+
+static struct outcome __clairvoyant;
+static unsigned long long __prediction_error = 0;
+static unsigned int __nr_predictions = 0;
+
+/**
+ * Values of a property to sweep over. Each value makes a variant of the
+ * scenario, and the variants are simulated as the lanes of a batch.
+ */
+enum sweep_property {
+	SWEEP_START,
+	SWEEP_LIFESPAN,
+	SWEEP_PRIO,
+	NR_SWEEP_PROPERTIES,
+};
+
+static const char *__sweep_property_sz[] = {
+	"start",
+	"lifespan",
+	"prio",
+};
+
+struct sweep {
+	struct process *process;	/* The thread for the lifespan */
+	enum sweep_property property;
+	unsigned int values[BATCH_LANES];
+	struct list_head list;
+};
+
+static LIST_HEAD(__sweeps);
+static unsigned int __nr_lanes = 0;
+
 void dump_status(void)
 {
 	struct process *p;
 
 	printf("***** CURRENT *********\n");
-	if (current) {
-		printf("%2d (%s): %d + %d/%d at %d\n",
-				current->pid, __process_status_sz[current->status],
-				current->__starts_at,
-				current->age, current->lifespan, current->prio);
+	if (nr_cpus <= 1) {
+		if (current) {
+			printf("%2d (%s): %d + %d/%d at %d\n",
+					current->pid, __process_status_sz[current->status],
+					current->__starts_at,
+					current->age, current->lifespan, current->prio);
+		}
+	} else {
+		for (int i = 0; i < nr_cpus; i++) {
+			struct cpu *c = cpus + i;
+			if (!c->current) {
+				printf("@%d: idle\n", i);
+				continue;
+			}
+			printf("@%d: %2d (%s): %d + %d/%d at %d\n", i,
+					c->current->pid, __process_status_sz[c->current->status],
+					c->current->__starts_at,
+					c->current->age, c->current->lifespan, c->current->prio);
+		}
 	}
 
 	printf("***** READY QUEUE *****\n");
@@ -103,6 +609,18 @@ void dump_status(void)
 				p->pid, __process_status_sz[p->status],
 				p->__starts_at, p->age, p->lifespan, p->prio);
 	}
+	for (int i = MAX_RT_PRIO - 1; i >= 0; i--) {
+		list_for_each_entry(p, __rt_queues + i, list) {
+			printf("%2d (%s): %d + %d/%d at %d (rt)\n",
+					p->pid, __process_status_sz[p->status],
+					p->__starts_at, p->age, p->lifespan, p->prio);
+		}
+	}
+	list_for_each_entry(p, &__idlequeue, list) {
+		printf("%2d (%s): %d + %d/%d at %d (idle)\n",
+				p->pid, __process_status_sz[p->status],
+				p->__starts_at, p->age, p->lifespan, p->prio);
+	}
 
 	printf("***** RESOURCES *******\n");
 	for (int i = 0; i < NR_RESOURCES; i++) {
@@ -115,317 +633,4430 @@ void dump_status(void)
 				printf("no one\n");
 			}
 
-			list_for_each_entry(p, &r->waitqueue, list) {
-				printf("    %d is waiting\n", p->pid);
+			list_for_each_entry(p, &r->waitqueue, list) {
+				printf("    %d is waiting\n", p->pid);
+			}
+		}
+	}
+	printf("\n\n");
+
+	return;
+}
+
+/**
+ * Kinds of the events printed out to stderr, which can be filtered
+ */
+enum event_kind {
+	EVENT_FORK,			/* N */
+	EVENT_EXIT,			/* X */
+	EVENT_RUN,			/* Running ticks */
+	EVENT_IDLE,			/* Idle ticks */
+	EVENT_BLOCK,		/* = */
+	EVENT_ACQUIRE,		/* +n */
+	EVENT_RELEASE,		/* -n */
+	EVENT_SPIN,			/* ~n */
+	EVENT_THROTTLE,		/* T */
+	EVENT_IO,			/* !n and Z */
+	EVENT_PRIO,			/* ^n */
+	EVENT_SYNC,			/* |n, >n, and <n */
+	EVENT_ADMIT,		/* D, R, and S */
+	EVENT_SWITCH,		/* Switch to another scheduler */
+	NR_EVENT_KINDS,
+};
+
+static const char *__event_kind_sz[] = {
+	"fork",
+	"exit",
+	"run",
+	"idle",
+	"block",
+	"acquire",
+	"release",
+	"spin",
+	"throttle",
+	"io",
+	"prio",
+	"sync",
+	"admit",
+	"switch",
+};
+
+/**
+ * Filters applied to the events before formatting them. An event is printed
+ * if its kind is in @kinds, its tick is in [@from, @to), and its process is
+ * in @pids unless @nr_pids is 0. Then, one in @every events is printed, or
+ * @reservoir events are sampled uniformly and printed at the end.
+ */
+#define MAX_TRACE_PIDS	64
+
+struct kept_event {
+	unsigned long long seq;
+	unsigned int tick;
+	int pid;
+	char text[64];
+};
+
+static struct {
+	unsigned int kinds;			/* Bitmap of the kinds to print */
+	bool filtering;				/* Whether any of the followings is set */
+
+	unsigned int pids[MAX_TRACE_PIDS];
+	unsigned int nr_pids;
+	unsigned int from;
+	unsigned int to;
+	unsigned int every;
+	unsigned int reservoir;
+
+	bool pid_field;				/* Print the pid as a field instead of indenting
+								   the event by it */
+
+	unsigned long long nr_matched;	/* # of events passed the filters */
+	unsigned long long nr_events;	/* # of the ones left after thinning by @every */
+	struct kept_event *kept;
+} __trace = {
+	.kinds = (1U << NR_EVENT_KINDS) - 1,
+	.to = -1,
+	.every = 1,
+};
+
+/**
+ * Check whether to print the event of process @pid, which is -1 for the
+ * events not about a process
+ */
+static bool __trace_event(int pid)
+{
+	if (!__trace.filtering) return true;
+
+	if (ticks < __trace.from || ticks >= __trace.to) return false;
+
+	if (__trace.nr_pids && pid >= 0) {
+		unsigned int i;
+		for (i = 0; i < __trace.nr_pids; i++) {
+			if (__trace.pids[i] == (unsigned int)pid) break;
+		}
+		if (i == __trace.nr_pids) return false;
+	}
+
+	if (__trace.nr_matched++ % __trace.every) return false;
+
+	/* The reservoir samples out of the thinned events */
+	__trace.nr_events++;
+	return true;
+}
+
+static void __format_event_prefix(unsigned int tick, int pid)
+{
+	fprintf(stderr, "%3d: ", tick);
+	if (__trace.pid_field) {
+		if (pid >= 0) fprintf(stderr, "%d ", pid);
+		return;
+	}
+	for (int i = 0; i < pid; i++) {
+		fprintf(stderr, "    ");
+	}
+}
+
+static void __format_event(unsigned int tick, int pid, const char *text)
+{
+	__format_event_prefix(tick, pid);
+	fprintf(stderr, "%s\n", text);
+}
+
+/**
+ * Keep the event in the reservoir, replacing a kept one at random once the
+ * reservoir is full so that every event is kept with the same probability
+ */
+static void __keep_event(int pid, const char *fmt, ...)
+{
+	unsigned long long seq = __trace.nr_events - 1;
+	struct kept_event *e;
+	va_list args;
+
+	if (seq < __trace.reservoir) {
+		e = __trace.kept + seq;
+	} else {
+		unsigned long long i = ((unsigned long long)rand() * RAND_MAX + rand()) % (seq + 1);
+		if (i >= __trace.reservoir) return;
+		e = __trace.kept + i;
+	}
+
+	e->seq = seq;
+	e->tick = ticks;
+	e->pid = pid;
+	va_start(args, fmt);
+	vsnprintf(e->text, sizeof(e->text), fmt, args);
+	va_end(args);
+}
+
+static int __compare_kept_events(const void *a, const void *b)
+{
+	const struct kept_event *ea = a, *eb = b;
+
+	return ea->seq < eb->seq ? -1 : ea->seq > eb->seq;
+}
+
+/**
+ * Print out the events in the reservoir in the order they happened
+ */
+static void __flush_kept_events(void)
+{
+	unsigned int nr_kept = __trace.nr_events < __trace.reservoir ?
+			__trace.nr_events : __trace.reservoir;
+
+	qsort(__trace.kept, nr_kept, sizeof(*__trace.kept), __compare_kept_events);
+	for (unsigned int i = 0; i < nr_kept; i++) {
+		__format_event(__trace.kept[i].tick, __trace.kept[i].pid, __trace.kept[i].text);
+	}
+}
+
+/**
+ * Print out the event of @kind. A disabled kind costs a branch
+ */
+#define __print_event(kind, pid, string, args...) do { \
+	if ((__trace.kinds & (1U << (kind))) && __trace_event(pid)) { \
+		if (__trace.reservoir) { \
+			__keep_event(pid, string, ##args); \
+		} else { \
+			__format_event_prefix(ticks, pid); \
+			fprintf(stderr, string "\n", ##args); \
+		} \
+	} \
+} while (0);
+
+/**
+ * Watchdog to alert processes waiting for too long. Each process has its
+ * timer armed to fire when it would have waited for the threshold, which is
+ * pushed back whenever the process runs. So, the watchdog does not need to
+ * scan the queues.
+ */
+static struct watchdog {
+	unsigned int ready;			/* Threshold to wait for the CPU. 0 to disable */
+	unsigned int blocked;		/* Threshold to wait for a resource */
+
+	unsigned int nr_ready_alerts;
+	unsigned int nr_blocked_alerts;
+	unsigned int longest_ready;
+	unsigned int longest_blocked;
+} __watchdog;
+
+static void __watchdog_expired(struct timer *timer)
+{
+	struct process *p = container_of(timer, struct process, __watchdog);
+	unsigned int waited = ticks - p->__waiting_since;
+	bool blocked;
+
+	if (p->status == PROCESS_WAIT && p->__blocked_on >= 0) {
+		blocked = true;
+		__watchdog.nr_blocked_alerts++;
+	} else if (p->status == PROCESS_READY) {
+		blocked = false;
+		__watchdog.nr_ready_alerts++;
+	} else {
+		return;
+	}
+
+	printf("ALERT tick=%d kind=%s pid=%d", ticks, blocked ? "blocked" : "ready", p->pid);
+	if (p->__tid) printf(" tid=%d", p->__tid);
+	if (blocked) printf(" resource=%d", p->__blocked_on);
+	printf(" waited=%d threshold=%d\n",
+			waited, blocked ? __watchdog.blocked : __watchdog.ready);
+
+	if (!quiet) dump_status();
+}
+
+/**
+ * Watch @p waiting for the CPU from @since
+ */
+static void __watch_ready(struct process *p, unsigned int since)
+{
+	p->__blocked_on = -1;
+	p->__waiting_since = since;
+
+	if (__watchdog.ready) {
+		add_timer(&p->__watchdog, since + __watchdog.ready);
+	} else {
+		del_timer(&p->__watchdog);
+	}
+}
+
+/**
+ * @p is now running after waiting for the CPU
+ */
+static void __watch_running(struct process *p)
+{
+	unsigned int waited = ticks - p->__waiting_since;
+
+	if (waited > __watchdog.longest_ready) __watchdog.longest_ready = waited;
+
+	/* It waits from the next tick unless it runs again */
+	__watch_ready(p, ticks + 1);
+}
+
+/**
+ * Watch @p blocked on resource @resource_id from now
+ */
+static void __watch_blocked(struct process *p, int resource_id)
+{
+	p->__blocked_on = resource_id;
+	p->__waiting_since = ticks;
+
+	if (__watchdog.blocked) {
+		add_timer(&p->__watchdog, ticks + __watchdog.blocked);
+	} else {
+		del_timer(&p->__watchdog);
+	}
+}
+
+/**
+ * @p is woken up, which might have been blocked on a resource
+ */
+static void __watch_woken(struct process *p)
+{
+	if (p->__blocked_on >= 0) {
+		unsigned int waited = ticks - p->__waiting_since;
+
+		if (waited > __watchdog.longest_blocked) __watchdog.longest_blocked = waited;
+	}
+	__watch_ready(p, ticks);
+}
+
+static inline bool strmatch(char * const str, const char *expect)
+{
+	return (strlen(str) == strlen(expect)) && (strncmp(str, expect, strlen(expect)) == 0);
+}
+
+static unsigned int __find_program(char * const name)
+{
+	for (int i = 0; i < __nr_programs; i++) {
+		if (strmatch(name, __programs[i].name)) return i;
+	}
+	assert(__nr_programs < MAX_NR_PROGRAMS);
+	strncpy(__programs[__nr_programs].name, name, sizeof(__programs->name) - 1);
+	return __nr_programs++;
+}
+
+static struct scheduler *__find_scheduler(char * const name)
+{
+	for (int i = 0; i < sizeof(__schedulers) / sizeof(*__schedulers); i++) {
+		if (strmatch(name, __schedulers[i].name)) return __schedulers[i].sched;
+	}
+	return NULL;
+}
+
+static struct device *__find_device(char * const name)
+{
+	for (int i = 0; i < __nr_devices; i++) {
+		if (strmatch(name, __devices[i].name)) return __devices + i;
+	}
+	return NULL;
+}
+
+static struct group *__find_group(char * const name)
+{
+	for (int i = 0; i < nr_groups; i++) {
+		if (strmatch(name, groups[i].name)) return groups + i;
+	}
+	return NULL;
+}
+
+static void __briefing_thread(struct process *t, const char *indent)
+{
+	struct resource_schedule *rs;
+	struct io_request *rq;
+	struct prio_schedule *ps;
+	struct barrier_schedule *bs;
+	struct message_schedule *ms;
+
+	if (t->__behavior) {
+		unsigned int nr_insns = 0;
+
+		for (unsigned int ip = 0; ip < t->__behavior->nr_words; ip++) {
+			if (BEHAVIOR_OP(t->__behavior->code[ip]) == OP_IO) ip++;
+			nr_insns++;
+		}
+		printf("%sRun a behavior of %u instructions\n", indent, nr_insns);
+	}
+
+	list_for_each_entry(rs, &t->__resources_to_acquire, list) {
+		printf("%sAcquire resource %d at %d for %d\n", indent,
+				rs->resource_id, rs->at, rs->duration);
+	}
+
+	list_for_each_entry(rq, &t->__io_to_issue, list) {
+		if (rq->device) {
+			printf("%sIssue I/O to %s at %d for %d\n", indent,
+					rq->device->name, rq->at, rq->duration);
+		} else {
+			printf("%sSleep at %d for %d\n", indent, rq->at, rq->duration);
+		}
+	}
+
+	list_for_each_entry(ps, &t->__prio_to_set, list) {
+		printf("%sSet priority to %d at %d\n", indent, ps->prio, ps->at);
+	}
+
+	list_for_each_entry(bs, &t->__barriers_to_reach, list) {
+		printf("%sWait at barrier %d at %d for %d processes\n", indent,
+				bs->barrier_id, bs->at, __barriers[bs->barrier_id].count);
+	}
+
+	list_for_each_entry(ms, &t->__messages_to_pass, list) {
+		printf("%s%s channel %d at %d\n", indent,
+				ms->send ? "Send to" : "Receive from", ms->channel_id, ms->at);
+	}
+}
+
+static void __briefing_process(struct process *p)
+{
+	struct process *t;
+	struct dependency *dep;
+	struct sweep *sw;
+	bool after = false;
+
+	if (quiet) return;
+
+	printf("- Process %d: Forked at tick %d and run for %d tick%s with initial priority %d\n",
+				p->pid, p->__starts_at, p->lifespan,
+				p->lifespan >= 2 ? "s" : "", p->prio);
+
+	if (p->sched_class != SCHED_CLASS_FAIR) {
+		printf("    Run in %s class\n", __sched_classes[p->sched_class].name);
+	}
+
+	list_for_each_entry(dep, &__dependencies, list) {
+		if (dep->process != p) continue;
+
+		printf("%s%d", after ? ", " : "    Run after process ", dep->pid);
+		after = true;
+	}
+	if (after) printf("\n");
+
+	list_for_each_entry(sw, &__sweeps, list) {
+		if (sw->process->__leader != p) continue;
+
+		printf("    Sweep %s", __sweep_property_sz[sw->property]);
+		if (sw->process->__tid) printf(" of thread %d", sw->process->__tid);
+		printf(" over");
+		for (int l = 0; l < __nr_lanes; l++) {
+			printf("%s %d", l ? "," : "", sw->values[l]);
+		}
+		printf("\n");
+	}
+
+	__briefing_thread(p, "    ");
+
+	if (p->__bandwidth) {
+		printf("    Run for %d tick%s every %d tick%s\n",
+				p->__bandwidth->quota, p->__bandwidth->quota >= 2 ? "s" : "",
+				p->__bandwidth->period, p->__bandwidth->period >= 2 ? "s" : "");
+	}
+
+	list_for_each_entry(t, &p->__threads, __sibling) {
+		printf("    Thread %d: Run for %d tick%s\n", t->__tid,
+				t->lifespan, t->lifespan >= 2 ? "s" : "");
+		__briefing_thread(t, "        ");
+	}
+}
+
+static void __refill_bandwidth(struct timer *timer);
+
+static struct bandwidth *__alloc_bandwidth(char * const quota, char * const period)
+{
+	struct bandwidth *bw = malloc(sizeof(*bw));
+
+	memset(bw, 0x00, sizeof(*bw));
+
+	bw->quota = bw->runtime = atoi(quota);
+	bw->period = atoi(period);
+	if (bw->quota == 0 || bw->period == 0) {
+		fprintf(stderr, "Invalid bandwidth %s / %s\n", quota, period);
+		free(bw);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&bw->throttled);
+	list_add_tail(&bw->list, &__bandwidths);
+
+	/* Refill the quota at the end of every period once armed */
+	timer_setup(&bw->period_timer, __refill_bandwidth);
+
+	return bw;
+}
+
+static struct process *__alloc_process(unsigned int pid)
+{
+	struct process *p = malloc(sizeof(*p));
+	memset(p, 0x00, sizeof(*p));
+
+	p->pid = pid;
+
+	INIT_LIST_HEAD(&p->list);
+	INIT_LIST_HEAD(&p->__resources_to_acquire);
+	INIT_LIST_HEAD(&p->__resources_holding);
+	INIT_LIST_HEAD(&p->__io_to_issue);
+	INIT_LIST_HEAD(&p->__prio_to_set);
+	INIT_LIST_HEAD(&p->__barriers_to_reach);
+	INIT_LIST_HEAD(&p->__messages_to_pass);
+	INIT_LIST_HEAD(&p->__successors);
+	INIT_LIST_HEAD(&p->__threads);
+	INIT_LIST_HEAD(&p->__sibling);
+
+	timer_setup(&p->__watchdog, __watchdog_expired);
+	p->__blocked_on = -1;
+
+	return p;
+}
+
+/**
+ * Validate the description of thread @t, and inherit the scheduling
+ * attributes of its process
+ */
+static bool __setup_thread(struct process *t)
+{
+	struct process *p = t->__leader;
+	struct io_request *rq;
+	struct prio_schedule *ps;
+	struct barrier_schedule *bs;
+	struct message_schedule *ms;
+
+	if (t != p) {
+		t->prio = p->prio;
+		t->prio_orig = p->prio_orig;
+		t->sched_class = p->sched_class;
+		t->group = p->group;
+		t->__starts_at = p->__starts_at;
+		t->__bandwidth = p->__bandwidth;
+		t->__program = p->__program;
+	}
+
+	if (t->__behavior) {
+		struct sweep *sw;
+
+		if (t->lifespan != t->__behavior->lifespan) {
+			fprintf(stderr, "Process %d: lifespan is given by the behavior\n", t->pid);
+			return false;
+		}
+		list_for_each_entry(sw, &__sweeps, list) {
+			if (sw->process == t && sw->property == SWEEP_LIFESPAN) {
+				fprintf(stderr, "Process %d: cannot sweep the lifespan of a behavior\n",
+						t->pid);
+				return false;
+			}
+		}
+	}
+
+	list_for_each_entry(ps, &t->__prio_to_set, list) {
+		if (ps->at >= t->lifespan) {
+			fprintf(stderr, "Process %d: priority change at %d should be before exit\n",
+					t->pid, ps->at);
+			return false;
+		}
+		if (t->sched_class == SCHED_CLASS_RT && ps->prio >= MAX_RT_PRIO) {
+			fprintf(stderr, "Process %d: rt priority should be less than %d\n",
+					t->pid, MAX_RT_PRIO);
+			return false;
+		}
+	}
+
+	list_for_each_entry(rq, &t->__io_to_issue, list) {
+		if (rq->at >= t->lifespan) {
+			fprintf(stderr, "Process %d: I/O or sleep at %d should be before exit\n",
+					t->pid, rq->at);
+			return false;
+		}
+	}
+
+	list_for_each_entry(bs, &t->__barriers_to_reach, list) {
+		if (bs->at >= t->lifespan) {
+			fprintf(stderr, "Process %d: barrier at %d should be before exit\n",
+					t->pid, bs->at);
+			return false;
+		}
+	}
+
+	list_for_each_entry(ms, &t->__messages_to_pass, list) {
+		if (ms->at >= t->lifespan) {
+			fprintf(stderr, "Process %d: message at %d should be before exit\n",
+					t->pid, ms->at);
+			return false;
+		}
+	}
+
+	if (t->sched_class == SCHED_CLASS_RT && t->prio >= MAX_RT_PRIO) {
+		fprintf(stderr, "Process %d: rt priority should be less than %d\n",
+				t->pid, MAX_RT_PRIO);
+		return false;
+	}
+
+	t->se.weight = DEFAULT_SHARES;
+	t->se.parent = t->group;
+	t->se.my_q = NULL;
+	INIT_HEAP_NODE(&t->se.run_node);
+
+	return true;
+}
+
+/**
+ * Ticks that the process takes to exit with unlimited CPUs
+ */
+static unsigned int __process_span(struct process *p)
+{
+	struct process *t;
+	unsigned int span = p->lifespan;
+
+	list_for_each_entry(t, &p->__threads, __sibling) {
+		if (t->lifespan > span) span = t->lifespan;
+	}
+	return span;
+}
+
+static struct process *__find_process(unsigned int pid)
+{
+	struct process *p;
+
+	list_for_each_entry(p, &__forkqueue, list) {
+		if (p->pid == pid) return p;
+	}
+	list_for_each_entry(p, &__dependents, list) {
+		if (p->pid == pid) return p;
+	}
+	return NULL;
+}
+
+/**
+ * Link the processes to their predecessors, and find the critical path by
+ * visiting them in a topological order
+ */
+static bool __resolve_dependencies(void)
+{
+	struct dependency *dep, *tmp;
+	struct process *p, **order;
+	unsigned int nr_processes = 0, head = 0, tail = 0;
+
+	list_for_each_entry_safe(dep, tmp, &__dependencies, list) {
+		struct process *pred = __find_process(dep->pid);
+
+		if (!pred || pred == dep->process) {
+			fprintf(stderr, "Process %d: invalid predecessor %d\n",
+					dep->process->pid, dep->pid);
+			return false;
+		}
+		list_move_tail(&dep->list, &pred->__successors);
+
+		if (dep->process->__nr_predecessors++ == 0) {
+			list_move_tail(&dep->process->list, &__dependents);
+		}
+	}
+
+	list_for_each_entry(p, &__forkqueue, list) nr_processes++;
+	list_for_each_entry(p, &__dependents, list) nr_processes++;
+	if (list_empty(&__dependents)) return true;
+
+	/* Kahn's algorithm. @__finish_at counts down the predecessors to visit */
+	order = malloc(sizeof(*order) * nr_processes);
+	list_for_each_entry(p, &__forkqueue, list) {
+		order[tail++] = p;
+	}
+	list_for_each_entry(p, &__dependents, list) {
+		p->__finish_at = p->__nr_predecessors;
+	}
+	while (head < tail) {
+		p = order[head++];
+		list_for_each_entry(dep, &p->__successors, list) {
+			if (--dep->process->__finish_at == 0) order[tail++] = dep->process;
+		}
+	}
+
+	if (tail < nr_processes) {
+		fprintf(stderr, "Processes depend on each other in a cycle\n");
+		free(order);
+		return false;
+	}
+
+	/**
+	 * A process can exit at the earliest when it runs from the later of its
+	 * start and the exits of its predecessors. @__finish_at holds the latter
+	 * until the process is visited.
+	 */
+	for (int i = 0; i < nr_processes; i++) {
+		p = order[i];
+		if (p->__finish_at < p->__starts_at) p->__finish_at = p->__starts_at;
+		p->__finish_at += __process_span(p);
+
+		if (p->__finish_at > __critical_path) __critical_path = p->__finish_at;
+
+		list_for_each_entry(dep, &p->__successors, list) {
+			if (dep->process->__finish_at < p->__finish_at) {
+				dep->process->__finish_at = p->__finish_at;
+			}
+		}
+	}
+	free(order);
+
+	return true;
+}
+
+/**
+ * Append @insn to the code of @b
+ */
+static void __emit_behavior(struct behavior *b, unsigned int insn)
+{
+	if (b->nr_words == b->max_words) {
+		b->max_words = b->max_words ? b->max_words * 2 : 16;
+		b->code = realloc(b->code, sizeof(*b->code) * b->max_words);
+	}
+	b->code[b->nr_words++] = insn;
+}
+
+/**
+ * Compile the 'do' block of thread @t from @file up to 'done'. The block
+ * should hold each resource across a compute, release all of them before the
+ * end, and have a compute in every loop, so that the thread never runs more
+ * than a loop body of instructions in a tick. The computes make the lifespan.
+ */
+static bool __compile_behavior(struct process *t, FILE *file)
+{
+	struct behavior *b = malloc(sizeof(*b));
+	struct {
+		unsigned int start;			/* Where the body starts */
+		unsigned int count;
+		unsigned long long ticks;	/* Ticks computed before the loop */
+		unsigned int held;			/* Resources held when entering */
+		bool computes;
+	} loops[MAX_LOOP_DEPTH];
+	unsigned int nr_loops = 0;
+	unsigned long long ticks = 0;
+	unsigned int held = 0;			/* Bitmap of the resources being held */
+	unsigned int computed = 0;		/* Resources held across a compute */
+	bool trailing_io = false;		/* I/O or sleep not followed by a compute */
+	char line[256];
+
+	memset(b, 0x00, sizeof(*b));
+	t->__behavior = b;
+
+	while (fgets(line, sizeof(line), file)) {
+		char *tokens[32] = { NULL };
+		int nr_tokens;
+		int operand;
+
+		parse_command(line, &nr_tokens, tokens);
+
+		if (nr_tokens == 0) continue;
+		if (strmatch(tokens[0], "done")) break;
+
+		operand = nr_tokens == 2 || nr_tokens == 3 ? atoi(tokens[1]) : 0;
+		if ((strmatch(tokens[0], "compute") || strmatch(tokens[0], "sleep") ||
+				strmatch(tokens[0], "io") || strmatch(tokens[0], "loop")) &&
+				(operand <= 0 || operand > MAX_BEHAVIOR_OPERAND)) {
+			fprintf(stderr, "Process %d: %s should be with 1 to %u\n",
+					t->pid, tokens[0], MAX_BEHAVIOR_OPERAND);
+			return false;
+		}
+
+		if (strmatch(tokens[0], "compute")) {
+			assert(nr_tokens == 2);
+			__emit_behavior(b, BEHAVIOR_INSN(OP_COMPUTE, operand));
+			ticks += operand;
+			computed |= held;
+			trailing_io = false;
+			if (nr_loops) loops[nr_loops - 1].computes = true;
+		} else if (strmatch(tokens[0], "acquire") || strmatch(tokens[0], "release")) {
+			assert(nr_tokens == 2);
+			if (operand < 0 || operand >= NR_RESOURCES) {
+				fprintf(stderr, "Resource %d is out of range\n", operand);
+				return false;
+			}
+			if (strmatch(tokens[0], "acquire")) {
+				if (held & (1U << operand)) {
+					fprintf(stderr, "Process %d: acquires resource %d again\n",
+							t->pid, operand);
+					return false;
+				}
+				held |= 1U << operand;
+				computed &= ~(1U << operand);
+				resources[operand].__used = true;
+				__emit_behavior(b, BEHAVIOR_INSN(OP_ACQUIRE, operand));
+			} else {
+				if (!(held & (1U << operand))) {
+					fprintf(stderr, "Process %d: releases resource %d not holding\n",
+							t->pid, operand);
+					return false;
+				}
+				if (!(computed & (1U << operand))) {
+					fprintf(stderr, "Process %d: holds resource %d without a compute\n",
+							t->pid, operand);
+					return false;
+				}
+				held &= ~(1U << operand);
+				__emit_behavior(b, BEHAVIOR_INSN(OP_RELEASE, operand));
+			}
+		} else if (strmatch(tokens[0], "sleep")) {
+			assert(nr_tokens == 2);
+			__emit_behavior(b, BEHAVIOR_INSN(OP_SLEEP, operand));
+			trailing_io = true;
+		} else if (strmatch(tokens[0], "io")) {
+			struct device *dev = __devices;
+			assert(nr_tokens == 2 || nr_tokens == 3);
+			if (nr_tokens == 3 && !(dev = __find_device(tokens[2]))) {
+				fprintf(stderr, "Unknown device %s\n", tokens[2]);
+				return false;
+			}
+			__emit_behavior(b, BEHAVIOR_INSN(OP_IO, operand));
+			__emit_behavior(b, dev->id);
+			trailing_io = true;
+		} else if (strmatch(tokens[0], "loop")) {
+			assert(nr_tokens == 2);
+			if (nr_loops == MAX_LOOP_DEPTH) {
+				fprintf(stderr, "Process %d: loops nested too deep (max %d)\n",
+						t->pid, MAX_LOOP_DEPTH);
+				return false;
+			}
+			__emit_behavior(b, BEHAVIOR_INSN(OP_LOOP, operand));
+			loops[nr_loops].start = b->nr_words;
+			loops[nr_loops].count = operand;
+			loops[nr_loops].ticks = ticks;
+			loops[nr_loops].held = held;
+			loops[nr_loops].computes = false;
+			nr_loops++;
+			ticks = 0;
+		} else if (strmatch(tokens[0], "endloop")) {
+			assert(nr_tokens == 1);
+			if (!nr_loops) {
+				fprintf(stderr, "Process %d: endloop without a loop\n", t->pid);
+				return false;
+			}
+			nr_loops--;
+			if (!loops[nr_loops].computes) {
+				fprintf(stderr, "Process %d: loop without a compute\n", t->pid);
+				return false;
+			}
+			if (loops[nr_loops].held != held) {
+				fprintf(stderr, "Process %d: loop should release what it acquires\n",
+						t->pid);
+				return false;
+			}
+			/* Jump back over the body and this endloop */
+			__emit_behavior(b, BEHAVIOR_INSN(OP_ENDLOOP,
+					b->nr_words + 1 - loops[nr_loops].start));
+			ticks = loops[nr_loops].ticks + ticks * loops[nr_loops].count;
+			if (nr_loops) loops[nr_loops - 1].computes = true;
+		} else {
+			fprintf(stderr, "Unknown behavior %s\n", tokens[0]);
+			return false;
+		}
+
+		if (ticks >= UNKNOWN_LIFESPAN) {
+			fprintf(stderr, "Process %d: behavior runs too long\n", t->pid);
+			return false;
+		}
+	}
+
+	if (nr_loops) {
+		fprintf(stderr, "Process %d: loop without endloop\n", t->pid);
+		return false;
+	}
+	if (held) {
+		fprintf(stderr, "Process %d: behavior ends holding resources\n", t->pid);
+		return false;
+	}
+	if (trailing_io) {
+		fprintf(stderr, "Process %d: I/O or sleep should be before exit\n", t->pid);
+		return false;
+	}
+	if (!ticks) {
+		fprintf(stderr, "Process %d: behavior without a compute\n", t->pid);
+		return false;
+	}
+
+	/* Keep the code as small as it is */
+	b->code = realloc(b->code, sizeof(*b->code) * b->nr_words);
+	b->max_words = b->nr_words;
+	b->lifespan = ticks;
+
+	t->lifespan = t->__lifespan = t->burst = b->lifespan;
+	return true;
+}
+
+static int __load_script(char * const filename)
+{
+	char line[256];
+	struct process *p = NULL;	/* The process being described */
+	struct process *t = NULL;	/* The thread of @p being described */
+
+	FILE *file = fopen(filename, "r");
+	while (fgets(line, sizeof(line), file)) {
+		char *tokens[32] = { NULL };
+		int nr_tokens;
+
+		parse_command(line, &nr_tokens, tokens);
+
+		if (nr_tokens == 0) continue;
+
+		if (strmatch(tokens[0], "cpu")) {
+			assert((nr_tokens == 2 || nr_tokens == 3) && !p);
+			/* Declare a CPU with the given capacity on the given core */
+			if (nr_cpus >= MAX_NR_CPUS) {
+				fprintf(stderr, "Too many CPUs (max %d)\n", MAX_NR_CPUS);
+				return false;
+			}
+			cpus[nr_cpus].capacity = atoi(tokens[1]);
+			cpus[nr_cpus].core = nr_tokens == 3 ? atoi(tokens[2]) : nr_cpus;
+			if (cpus[nr_cpus].capacity == 0) {
+				fprintf(stderr, "CPU %d has zero capacity\n", nr_cpus);
+				return false;
+			}
+			if (cpus[nr_cpus].core >= MAX_NR_CPUS) {
+				fprintf(stderr, "Core %d is out of range\n", cpus[nr_cpus].core);
+				return false;
+			}
+			nr_cpus++;
+
+			continue;
+		} else if (strmatch(tokens[0], "topology")) {
+			int nr_cores, nr_threads;
+			unsigned int core;
+			assert(nr_tokens == 3 && !p);
+			/* Declare @nr_cores nominal cores with @nr_threads threads each */
+			nr_cores = atoi(tokens[1]);
+			nr_threads = atoi(tokens[2]);
+			if (nr_cores <= 0 || nr_threads <= 0 ||
+					nr_cpus + nr_cores * nr_threads > MAX_NR_CPUS) {
+				fprintf(stderr, "Invalid topology %s x %s\n", tokens[1], tokens[2]);
+				return false;
+			}
+			/* Number the cores following the ones already declared */
+			core = 0;
+			for (int i = 0; i < nr_cpus; i++) {
+				if (cpus[i].core >= core) core = cpus[i].core + 1;
+			}
+			if (core + nr_cores > MAX_NR_CPUS) {
+				fprintf(stderr, "Core %d is out of range\n", core + nr_cores - 1);
+				return false;
+			}
+			for (int i = 0; i < nr_cores; i++, core++) {
+				for (int j = 0; j < nr_threads; j++) {
+					cpus[nr_cpus].capacity = CAPACITY_SCALE;
+					cpus[nr_cpus].core = core;
+					nr_cpus++;
+				}
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "smt")) {
+			assert(nr_tokens == 2 && !p);
+			/* Throughput of a thread while its siblings are busy */
+			smt_rate = atoi(tokens[1]);
+			if (smt_rate == 0 || smt_rate > CAPACITY_SCALE) {
+				fprintf(stderr, "SMT rate should be in (0, %d]\n", CAPACITY_SCALE);
+				return false;
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "aging")) {
+			assert(nr_tokens == 3 && !p);
+			/* Raise the priority of waiting processes periodically */
+			aging_step = atoi(tokens[1]);
+			aging_period = atoi(tokens[2]);
+			if (aging_period == 0) {
+				fprintf(stderr, "Aging period should be positive\n");
+				return false;
+			}
+			if (!quiet) {
+				printf("- Raise the priority of waiting processes by %d every %d tick%s\n",
+						aging_step, aging_period, aging_period >= 2 ? "s" : "");
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "watchdog")) {
+			assert(nr_tokens == 3 && !p);
+			/* Alert processes waiting for too long */
+			__watchdog.ready = atoi(tokens[1]);
+			__watchdog.blocked = atoi(tokens[2]);
+			if (!quiet) {
+				printf("- Alert processes waiting %d ticks for the CPU or %d ticks for a resource\n",
+						__watchdog.ready, __watchdog.blocked);
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "resource")) {
+			int resource_id;
+			assert(nr_tokens == 3 && !p);
+			/* Declare how processes wait for the resource */
+			resource_id = atoi(tokens[1]);
+			if (resource_id < 0 || resource_id >= NR_RESOURCES) {
+				fprintf(stderr, "Resource %d is out of range\n", resource_id);
+				return false;
+			}
+			if (strmatch(tokens[2], "sleep")) {
+				resources[resource_id].type = RESOURCE_SLEEP;
+			} else if (strmatch(tokens[2], "spin")) {
+				resources[resource_id].type = RESOURCE_SPIN;
+			} else if (strmatch(tokens[2], "adaptive")) {
+				resources[resource_id].type = RESOURCE_ADAPTIVE;
+			} else {
+				fprintf(stderr, "Unknown resource type %s\n", tokens[2]);
+				return false;
+			}
+			if (!quiet) {
+				printf("- Resource %d: %s lock\n", resource_id, tokens[2]);
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "channel") && !p) {
+			unsigned int id;
+			assert(nr_tokens == 3);
+
+			id = atoi(tokens[1]);
+			if (id >= MAX_NR_CHANNELS) {
+				fprintf(stderr, "Channel %d is not in between 0 and %d\n",
+						id, MAX_NR_CHANNELS - 1);
+				return false;
+			}
+			__channels[id].capacity = atoi(tokens[2]);
+			if (!quiet) {
+				printf("- Channel %d: hold up to %d message%s\n", id,
+						__channels[id].capacity, __channels[id].capacity != 1 ? "s" : "");
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "group") && !p) {
+			struct group *g, *parent = groups;
+			assert(nr_tokens == 3 || nr_tokens == 4);
+			/* Declare a group with the shares under the parent group */
+			if (nr_groups >= MAX_NR_GROUPS) {
+				fprintf(stderr, "Too many groups (max %d)\n", MAX_NR_GROUPS);
+				return false;
+			}
+			if (__find_group(tokens[1]) || strlen(tokens[1]) >= sizeof(g->name)) {
+				fprintf(stderr, "Invalid group name %s\n", tokens[1]);
+				return false;
+			}
+			if (nr_tokens == 4 && !(parent = __find_group(tokens[3]))) {
+				fprintf(stderr, "Unknown parent group %s\n", tokens[3]);
+				return false;
+			}
+
+			g = groups + nr_groups;
+			g->id = nr_groups++;
+			strcpy(g->name, tokens[1]);
+			g->shares = atoi(tokens[2]);
+			g->parent = parent;
+			if (g->shares == 0) {
+				fprintf(stderr, "Group %s has zero shares\n", g->name);
+				return false;
+			}
+
+			g->se.weight = g->shares;
+			g->se.parent = parent;
+			g->se.my_q = g;
+			INIT_HEAP_NODE(&g->se.run_node);
+
+			if (!quiet) {
+				printf("- Group %s: %d shares under %s\n", g->name, g->shares, parent->name);
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "device") && !p) {
+			struct device *dev;
+			int i;
+			assert(nr_tokens == 3 || nr_tokens == 4);
+			/* Declare a device, or configure the default one */
+			if (!(dev = __find_device(tokens[1]))) {
+				if (__nr_devices >= MAX_NR_DEVICES) {
+					fprintf(stderr, "Too many devices (max %d)\n", MAX_NR_DEVICES);
+					return false;
+				}
+				if (strlen(tokens[1]) >= sizeof(dev->name)) {
+					fprintf(stderr, "Invalid device name %s\n", tokens[1]);
+					return false;
+				}
+				dev = __devices + __nr_devices;
+				dev->id = __nr_devices++;
+				strcpy(dev->name, tokens[1]);
+				INIT_LIST_HEAD(&dev->queue);
+			}
+
+			dev->parallelism = atoi(tokens[2]);
+			if (dev->parallelism == 0) {
+				fprintf(stderr, "Device %s should serve at least one request\n", dev->name);
+				return false;
+			}
+
+			dev->discipline = IO_FIFO;
+			if (nr_tokens == 4) {
+				for (i = 0; i < sizeof(__io_discipline_sz) / sizeof(*__io_discipline_sz); i++) {
+					if (strmatch(tokens[3], (char *)__io_discipline_sz[i])) break;
+				}
+				if (i == sizeof(__io_discipline_sz) / sizeof(*__io_discipline_sz)) {
+					fprintf(stderr, "Unknown I/O discipline %s\n", tokens[3]);
+					return false;
+				}
+				dev->discipline = i;
+			}
+
+			if (!quiet) {
+				printf("- Device %d %s: Serve %d request%s at a time in %s order\n",
+						dev->id, dev->name, dev->parallelism,
+						dev->parallelism != 1 ? "s" : "",
+						__io_discipline_sz[dev->discipline]);
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "bandwidth") && !p) {
+			struct group *g;
+			assert(nr_tokens == 4);
+			/* Limit the CPU bandwidth of the group */
+			if (!(g = __find_group(tokens[1]))) {
+				fprintf(stderr, "Unknown group %s\n", tokens[1]);
+				return false;
+			}
+			if (g->__bandwidth) {
+				fprintf(stderr, "Group %s is already limited\n", g->name);
+				return false;
+			}
+			if (!(g->__bandwidth = __alloc_bandwidth(tokens[2], tokens[3]))) {
+				return false;
+			}
+			sprintf(g->__bandwidth->name, "group %s", g->name);
+
+			/* Groups are there from the beginning */
+			add_timer(&g->__bandwidth->period_timer, g->__bandwidth->period);
+
+			if (!quiet) {
+				printf("- Group %s: Run for %d tick%s every %d tick%s\n", g->name,
+						g->__bandwidth->quota, g->__bandwidth->quota >= 2 ? "s" : "",
+						g->__bandwidth->period, g->__bandwidth->period >= 2 ? "s" : "");
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "admit") && !p) {
+			struct admission *a = &__admission;
+			int i, next;
+			assert(nr_tokens >= 3);
+			/* Limit the processes to admit */
+			for (i = 0; i < sizeof(__admission_limit_sz) / sizeof(*__admission_limit_sz); i++) {
+				if (strmatch(tokens[1], __admission_limit_sz[i])) break;
+			}
+			if (i == ADMIT_ALL || i == sizeof(__admission_limit_sz) / sizeof(*__admission_limit_sz)) {
+				fprintf(stderr, "Unknown admission limit %s\n", tokens[1]);
+				return false;
+			}
+			a->limit = i;
+			a->value = atoi(tokens[2]);
+			next = 3;
+			if (a->limit == ADMIT_RATE) {
+				assert(nr_tokens >= 4);
+				a->period = atoi(tokens[3]);
+				if (!a->value || !a->period) {
+					fprintf(stderr, "Admission rate should be positive\n");
+					return false;
+				}
+				a->tokens = (unsigned long long)a->value * a->period;
+				next = 4;
+			}
+
+			/* And what to do with the ones beyond the limit */
+			a->action = ADMIT_REJECT;
+			if (next < nr_tokens) {
+				for (i = 0; i < sizeof(__admission_action_sz) / sizeof(*__admission_action_sz); i++) {
+					if (strmatch(tokens[next], __admission_action_sz[i])) break;
+				}
+				if (i == sizeof(__admission_action_sz) / sizeof(*__admission_action_sz)) {
+					fprintf(stderr, "Unknown admission action %s\n", tokens[next]);
+					return false;
+				}
+				a->action = i;
+				if (a->action == ADMIT_SHED) {
+					assert(nr_tokens == next + 2);
+					a->depth = atoi(tokens[next + 1]);
+				}
+			}
+
+			if (!quiet) {
+				printf("- Admit processes up to %d %s", a->value,
+						a->limit == ADMIT_RUNNABLE ? "runnable processes" :
+						a->limit == ADMIT_RATE ? "processes" : "ticks of predicted wait");
+				if (a->limit == ADMIT_RATE) {
+					printf(" every %d tick%s", a->period, a->period >= 2 ? "s" : "");
+				}
+				printf(", and %s the others", __admission_action_sz[a->action]);
+				if (a->action == ADMIT_SHED) {
+					printf(" beyond %d held back", a->depth);
+				}
+				printf("\n");
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "monitor")) {
+			assert(nr_tokens == 2 && !p);
+			/* Evaluate the switch rules every window */
+			__monitor.window = atoi(tokens[1]);
+			if (__monitor.window == 0) {
+				fprintf(stderr, "Monitoring window should be positive\n");
+				return false;
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "rule")) {
+			struct switch_rule *rule;
+			int i;
+			assert(nr_tokens == 5 && !p);
+			/* Switch to the scheduler when the metric meets the condition */
+			rule = malloc(sizeof(*rule));
+
+			if (!(rule->sched = __find_scheduler(tokens[1]))) {
+				fprintf(stderr, "Unknown scheduler %s\n", tokens[1]);
+				return false;
+			}
+			for (i = 0; i < NR_METRICS; i++) {
+				if (strmatch(tokens[2], (char *)__metric_sz[i])) break;
+			}
+			if (i == NR_METRICS) {
+				fprintf(stderr, "Unknown metric %s\n", tokens[2]);
+				return false;
+			}
+			rule->metric = i;
+			if (!strmatch(tokens[3], "<") && !strmatch(tokens[3], "<=") &&
+					!strmatch(tokens[3], ">") && !strmatch(tokens[3], ">=")) {
+				fprintf(stderr, "Unknown operator %s\n", tokens[3]);
+				return false;
+			}
+			strcpy(rule->op, tokens[3]);
+			rule->value = atof(tokens[4]);
+
+			list_add_tail(&rule->list, &__switch_rules);
+
+			if (!quiet) {
+				printf("- Switch to %s scheduler if %s %s %s\n",
+						rule->sched->name, tokens[2], tokens[3], tokens[4]);
+			}
+
+			continue;
+		} else if (strmatch(tokens[0], "process")) {
+			assert(nr_tokens == 2);
+			/* Start processor description */
+			p = t = __alloc_process(atoi(tokens[1]));
+
+			p->group = groups;
+			p->sched_class = SCHED_CLASS_FAIR;
+			p->__leader = p;
+			p->__nr_threads = 1;
+
+			continue;
+		} else if (strmatch(tokens[0], "thread")) {
+			assert(nr_tokens == 2 && p);
+			/* Start describing a new thread of the process */
+			t = __alloc_process(p->pid);
+
+			t->lifespan = t->__lifespan = t->burst = atoi(tokens[1]);
+			t->__leader = p;
+			t->__tid = p->__nr_threads++;
+			list_add_tail(&t->__sibling, &p->__threads);
+
+			continue;
+		} else if (strmatch(tokens[0], "end")) {
+			/* End of process description */
+			struct process *thread;
+			assert(p);
+
+			if (!__setup_thread(p)) return false;
+			list_for_each_entry(thread, &p->__threads, __sibling) {
+				if (!__setup_thread(thread)) return false;
+			}
+
+			list_add_tail(&p->list, &__forkqueue);
+
+			__briefing_process(p);
+			p = t = NULL;
+
+			continue;
+		} else if (strmatch(tokens[0], "do")) {
+			assert(nr_tokens == 1 && t && !t->__behavior);
+			/* Compile the behavior of the thread up to 'done' */
+			if (!__compile_behavior(t, file)) return false;
+
+			continue;
+		}
+
+		if (strmatch(tokens[0], "lifespan")) {
+			assert(nr_tokens == 2);
+			t->lifespan = t->__lifespan = t->burst = atoi(tokens[1]);
+		} else if (strmatch(tokens[0], "program")) {
+			assert(nr_tokens == 2);
+			p->__program = __find_program(tokens[1]);
+		} else if (strmatch(tokens[0], "prio")) {
+			assert(nr_tokens == 2);
+			p->prio = p->prio_orig = atoi(tokens[1]);
+		} else if (strmatch(tokens[0], "start")) {
+			assert(nr_tokens == 2);
+			p->__starts_at = atoi(tokens[1]);
+		} else if (strmatch(tokens[0], "group")) {
+			assert(nr_tokens == 2);
+			if (!(p->group = __find_group(tokens[1]))) {
+				fprintf(stderr, "Unknown group %s\n", tokens[1]);
+				return false;
+			}
+		} else if (strmatch(tokens[0], "bandwidth")) {
+			assert(nr_tokens == 3 && !p->__bandwidth);
+			if (!(p->__bandwidth = __alloc_bandwidth(tokens[1], tokens[2]))) {
+				return false;
+			}
+			sprintf(p->__bandwidth->name, "process %d", p->pid);
+		} else if (strmatch(tokens[0], "class")) {
+			assert(nr_tokens == 2);
+			if (strmatch(tokens[1], "rt")) {
+				p->sched_class = SCHED_CLASS_RT;
+			} else if (strmatch(tokens[1], "fair")) {
+				p->sched_class = SCHED_CLASS_FAIR;
+			} else if (strmatch(tokens[1], "idle")) {
+				p->sched_class = SCHED_CLASS_IDLE;
+			} else {
+				fprintf(stderr, "Unknown scheduling class %s\n", tokens[1]);
+				return false;
+			}
+		} else if (strmatch(tokens[0], "acquire")) {
+			struct resource_schedule *rs;
+			assert(nr_tokens == 4);
+
+			rs = malloc(sizeof(*rs));
+
+			rs->resource_id = atoi(tokens[1]);
+			rs->at = atoi(tokens[2]);
+			rs->duration = atoi(tokens[3]);
+			if (rs->resource_id >= 0 && rs->resource_id < NR_RESOURCES) {
+				resources[rs->resource_id].__used = true;
+			}
+
+			list_add_tail(&rs->list, &t->__resources_to_acquire);
+		} else if (strmatch(tokens[0], "io")) {
+			struct io_request *rq;
+			assert(nr_tokens == 3 || nr_tokens == 4);
+
+			rq = malloc(sizeof(*rq));
+
+			rq->at = atoi(tokens[1]);
+			rq->duration = atoi(tokens[2]);
+			rq->device = __devices;
+			rq->process = t;
+			if (nr_tokens == 4 && !(rq->device = __find_device(tokens[3]))) {
+				fprintf(stderr, "Unknown device %s\n", tokens[3]);
+				return false;
+			}
+			if (rq->duration == 0) {
+				fprintf(stderr, "Process %d: I/O at %d takes no time\n", p->pid, rq->at);
+				return false;
+			}
+
+			list_add_tail(&rq->list, &t->__io_to_issue);
+		} else if (strmatch(tokens[0], "after")) {
+			assert(nr_tokens >= 2);
+			/* Predecessors are separated by commas and/or spaces */
+			for (int i = 1; i < nr_tokens; i++) {
+				for (char *pid = strtok(tokens[i], ","); pid; pid = strtok(NULL, ",")) {
+					struct dependency *dep = malloc(sizeof(*dep));
+
+					dep->pid = atoi(pid);
+					dep->process = p;
+					list_add_tail(&dep->list, &__dependencies);
+				}
+			}
+		} else if (strmatch(tokens[0], "setprio")) {
+			struct prio_schedule *ps, *pos;
+			assert(nr_tokens == 3);
+
+			ps = malloc(sizeof(*ps));
+
+			ps->at = atoi(tokens[1]);
+			ps->prio = atoi(tokens[2]);
+
+			/* Keep the changes in the order of the age */
+			list_for_each_entry_reverse(pos, &t->__prio_to_set, list) {
+				if (pos->at <= ps->at) break;
+			}
+			list_add(&ps->list, &pos->list);
+		} else if (strmatch(tokens[0], "barrier")) {
+			struct barrier_schedule *bs;
+			struct barrier *b;
+			unsigned int id, count;
+			assert(nr_tokens == 4);
+
+			id = atoi(tokens[1]);
+			count = atoi(tokens[3]);
+			if (id >= MAX_NR_BARRIERS) {
+				fprintf(stderr, "Barrier %d is not in between 0 and %d\n",
+						id, MAX_NR_BARRIERS - 1);
+				return false;
+			}
+			b = __barriers + id;
+			if (!count) {
+				fprintf(stderr, "Barrier %d should wait for at least one process\n", id);
+				return false;
+			}
+			if (b->count && b->count != count) {
+				fprintf(stderr, "Process %d: barrier %d is for %d processes\n",
+						p->pid, id, b->count);
+				return false;
+			}
+			b->count = count;
+
+			bs = malloc(sizeof(*bs));
+
+			bs->barrier_id = id;
+			bs->at = atoi(tokens[2]);
+			bs->process = t;
+
+			list_add_tail(&bs->list, &t->__barriers_to_reach);
+		} else if (strmatch(tokens[0], "send") || strmatch(tokens[0], "recv")) {
+			struct message_schedule *ms;
+			unsigned int id;
+			assert(nr_tokens == 3);
+
+			id = atoi(tokens[1]);
+			if (id >= MAX_NR_CHANNELS) {
+				fprintf(stderr, "Channel %d is not in between 0 and %d\n",
+						id, MAX_NR_CHANNELS - 1);
+				return false;
+			}
+
+			ms = malloc(sizeof(*ms));
+
+			ms->channel_id = id;
+			ms->at = atoi(tokens[2]);
+			ms->send = strmatch(tokens[0], "send");
+			ms->process = t;
+
+			list_add_tail(&ms->list, &t->__messages_to_pass);
+		} else if (strmatch(tokens[0], "sweep")) {
+			struct sweep *sw;
+			int i;
+			assert(nr_tokens >= 3);
+			/* Simulate a variant of the scenario for each value */
+			for (i = 0; i < NR_SWEEP_PROPERTIES; i++) {
+				if (strmatch(tokens[1], __sweep_property_sz[i])) break;
+			}
+			if (i == NR_SWEEP_PROPERTIES) {
+				fprintf(stderr, "Unknown property %s to sweep\n", tokens[1]);
+				return false;
+			}
+			if (nr_tokens - 2 > BATCH_LANES ||
+					(__nr_lanes && nr_tokens - 2 != __nr_lanes)) {
+				fprintf(stderr, "Process %d: sweep %d values instead of %d\n", p->pid,
+						nr_tokens - 2, __nr_lanes ? __nr_lanes : BATCH_LANES);
+				return false;
+			}
+			__nr_lanes = nr_tokens - 2;
+
+			sw = malloc(sizeof(*sw));
+
+			sw->process = i == SWEEP_LIFESPAN ? t : p;
+			sw->property = i;
+			for (i = 0; i < __nr_lanes; i++) {
+				sw->values[i] = atoi(tokens[i + 2]);
+			}
+
+			list_add_tail(&sw->list, &__sweeps);
+		} else if (strmatch(tokens[0], "sleep")) {
+			struct io_request *rq;
+			assert(nr_tokens == 3);
+
+			rq = malloc(sizeof(*rq));
+
+			rq->at = atoi(tokens[1]);
+			rq->duration = atoi(tokens[2]);
+			rq->device = NULL;
+			rq->process = t;
+
+			list_add_tail(&rq->list, &t->__io_to_issue);
+		} else {
+			fprintf(stderr, "Unknown property %s\n", tokens[0]);
+			return false;
+		}
+	}
+	fclose(file);
+	if (!quiet) printf("\n");
+
+	return __resolve_dependencies();
+}
+
+
+/***********************************************************************
+ * Import of Linux scheduler traces
+ *
+ * The text output of ftrace (with sched_switch and sched_wakeup enabled)
+ * or 'perf sched script' is turned into processes. A task arrives when it
+ * is first seen, runs as long as it was on CPUs in the trace, and sleeps
+ * while it was off CPUs after blocking until it was woken up. The time
+ * spent preempted is left to the scheduler to simulate. The tasks are
+ * numbered from 1 in the order of arrival. The trace is read line by line,
+ * and only the tasks are kept in memory.
+ */
+#define IMPORT_HASH_BITS	10
+#define TASK_COMM_LEN		16
+
+struct imported_task {
+	unsigned int pid;			/* PID in the trace */
+	char comm[TASK_COMM_LEN];
+	struct process *process;
+
+	bool running;
+	bool sleeping;
+	unsigned long long since;	/* When switched in, or started sleeping */
+	unsigned long long ran;		/* Microseconds on CPUs so far */
+
+	struct list_head hash;
+	struct list_head list;		/* In the order of arrival */
+};
+
+static unsigned int __import_tick = 0;	/* Microseconds per tick. 0 if not importing */
+static struct list_head __imported_tasks[1 << IMPORT_HASH_BITS];
+static LIST_HEAD(__imported_order);
+
+static inline unsigned int __import_ticks(unsigned long long usecs)
+{
+	return (usecs + __import_tick / 2) / __import_tick;
+}
+
+/**
+ * Find the task @pid, or start a process for it seen first at @now with
+ * the kernel priority @kprio
+ */
+static struct imported_task *__find_imported_task(unsigned int pid, const char *comm,
+		unsigned long long now, unsigned long long origin, int kprio)
+{
+	struct list_head *bucket = __imported_tasks + (pid & ((1 << IMPORT_HASH_BITS) - 1));
+	struct imported_task *task;
+	struct process *p;
+
+	list_for_each_entry(task, bucket, hash) {
+		if (task->pid == pid) return task;
+	}
+
+	task = malloc(sizeof(*task));
+	memset(task, 0x00, sizeof(*task));
+	task->pid = pid;
+	strncpy(task->comm, comm, TASK_COMM_LEN - 1);
+	list_add(&task->hash, bucket);
+	list_add_tail(&task->list, &__imported_order);
+
+	/* Numbered once known to run. See __import_trace() */
+	task->process = p = __alloc_process(0);
+	p->group = groups;
+	p->__leader = p;
+	p->__nr_threads = 1;
+	p->__starts_at = __import_ticks(now - origin);
+
+	/* Kernel priorities 0-99 are real-time ones with 0 the most important */
+	if (kprio >= 0 && kprio < MAX_RT_PRIO) {
+		p->sched_class = SCHED_CLASS_RT;
+		p->prio = p->prio_orig = MAX_RT_PRIO - 1 - kprio;
+	} else {
+		p->sched_class = SCHED_CLASS_FAIR;
+		p->prio = p->prio_orig = kprio > 139 ? 0 : 139 - (kprio < 100 ? 120 : kprio);
+	}
+	return task;
+}
+
+/**
+ * Wake up @task sleeping since @task->since, scheduling the sleep at the
+ * age that the task had run by then
+ */
+static void __wake_imported_task(struct imported_task *task, unsigned long long now)
+{
+	struct process *p = task->process;
+	struct io_request *rq;
+	unsigned int at = __import_ticks(task->ran);
+	unsigned int duration = __import_ticks(now - task->since);
+
+	task->sleeping = false;
+	if (!duration) return;
+
+	/* Merge the sleeps at the same age */
+	if (!list_empty(&p->__io_to_issue)) {
+		rq = list_last_entry(&p->__io_to_issue, struct io_request, list);
+		if (rq->at == at) {
+			rq->duration += duration;
+			return;
+		}
+	}
+
+	rq = malloc(sizeof(*rq));
+	rq->at = at;
+	rq->duration = duration;
+	rq->device = NULL;
+	rq->process = p;
+	list_add_tail(&rq->list, &p->__io_to_issue);
+}
+
+/**
+ * Get the value of @key=value in @args
+ */
+static char *__trace_field(char *args, const char *key)
+{
+	size_t len = strlen(key);
+
+	for (char *s = strstr(args, key); s; s = strstr(s + 1, key)) {
+		if ((s == args || s[-1] == ' ') && s[len] == '=') return s + len + 1;
+	}
+	return NULL;
+}
+
+/**
+ * Copy the comm of @len (up to the space if negative) at @s into @comm
+ */
+static void __trace_comm(const char *s, int len, char *comm)
+{
+	if (len < 0) len = s ? strcspn(s, " ") : 0;
+	if (len >= TASK_COMM_LEN) len = TASK_COMM_LEN - 1;
+
+	if (len) memcpy(comm, s, len);
+	comm[len] = '\0';
+}
+
+/**
+ * Parse the task in the form of 'comm:pid [prio]' that perf prints
+ */
+static bool __trace_task(char *s, unsigned int *pid, int *kprio, char *comm)
+{
+	char *bracket = strstr(s, " [");
+	char *colon;
+
+	if (!bracket) return false;
+	*bracket = '\0';
+	colon = strrchr(s, ':');
+	*bracket = ' ';
+	if (!colon) return false;
+
+	*pid = atoi(colon + 1);
+	*kprio = atoi(bracket + 2);
+	__trace_comm(s, colon - s, comm);
+	return true;
+}
+
+static bool __import_trace(char * const filename)
+{
+	char line[1024];
+	unsigned long long origin = 0, now = 0;
+	bool started = false;
+	int max_cpu = -1;
+	struct imported_task *task, *tmp;
+	unsigned int nr_events = 0, nr_processes = 0;
+
+	FILE *file = fopen(filename, "r");
+	if (!file) {
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return false;
+	}
+
+	for (int i = 0; i < (1 << IMPORT_HASH_BITS); i++) {
+		INIT_LIST_HEAD(__imported_tasks + i);
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		char *event, *args, *stamp, *bracket;
+		bool wakeup;
+
+		if (line[0] == '#') continue;
+		line[strcspn(line, "\n")] = '\0';
+
+		/* ftrace prints 'sched_switch:', and perf 'sched:sched_switch:' */
+		if ((event = strstr(line, "sched_switch: "))) {
+			wakeup = false;
+		} else if ((event = strstr(line, "sched_wakeup: ")) ||
+				(event = strstr(line, "sched_wakeup_new: "))) {
+			wakeup = true;
+		} else {
+			continue;
+		}
+		args = strchr(event, ' ') + 1;
+		if (event - line >= 6 && !strncmp(event - 6, "sched:", 6)) event -= 6;
+
+		/* The timestamp in seconds right before the event, and the CPU */
+		while (event > line && (event[-1] == ' ' || event[-1] == ':')) event--;
+		*event = '\0';
+		if (!(stamp = strrchr(line, ' '))) continue;
+		now = strtod(stamp + 1, NULL) * 1000000 + 0.5;
+
+		if ((bracket = strchr(line, '[')) && bracket < stamp) {
+			int cpu = atoi(bracket + 1);
+			if (cpu > max_cpu) max_cpu = cpu;
+		}
+
+		if (!started) {
+			origin = now;
+			started = true;
+		}
+		nr_events++;
+
+		if (wakeup) {
+			char *pid = __trace_field(args, "pid");
+			char *prio = __trace_field(args, "prio");
+			char comm[TASK_COMM_LEN];
+			unsigned int p;
+			int kprio = 120;
+
+			if (pid) {
+				p = atoi(pid);
+				if (prio) kprio = atoi(prio);
+				__trace_comm(__trace_field(args, "comm"), -1, comm);
+			} else if (!__trace_task(args, &p, &kprio, comm)) {
+				continue;
+			}
+			if (!p) continue;
+
+			task = __find_imported_task(p, comm, now, origin, kprio);
+			if (task->sleeping) __wake_imported_task(task, now);
+		} else {
+			char *prev_pid = __trace_field(args, "prev_pid");
+			char *next_pid = __trace_field(args, "next_pid");
+			char *arrow = strstr(args, " ==> ");
+			unsigned int prev, next;
+			int prev_prio = 120, next_prio = 120;
+			char prev_comm[TASK_COMM_LEN], next_comm[TASK_COMM_LEN];
+			char state = 'R';
+
+			if (!arrow) continue;
+			if (prev_pid && next_pid) {
+				char *field;
+
+				prev = atoi(prev_pid);
+				next = atoi(next_pid);
+				__trace_comm(__trace_field(args, "prev_comm"), -1, prev_comm);
+				__trace_comm(__trace_field(args, "next_comm"), -1, next_comm);
+				if ((field = __trace_field(args, "prev_prio"))) prev_prio = atoi(field);
+				if ((field = __trace_field(args, "next_prio"))) next_prio = atoi(field);
+				if ((field = __trace_field(args, "prev_state"))) state = field[0];
+			} else {
+				*arrow = '\0';
+				if (!__trace_task(args, &prev, &prev_prio, prev_comm) ||
+						!__trace_task(arrow + 5, &next, &next_prio, next_comm)) {
+					continue;
+				}
+				state = strchr(args, ']') ? strchr(args, ']')[2] : 'R';
+			}
+
+			if (prev) {
+				task = __find_imported_task(prev, prev_comm, now, origin, prev_prio);
+				if (task->running) {
+					task->ran += now - task->since;
+					task->running = false;
+				}
+				/* Blocked unless preempted. A dead task does not come back */
+				if (state != 'R' && state != 'X' && state != 'Z') {
+					task->sleeping = true;
+					task->since = now;
+				}
+			}
+			if (next) {
+				task = __find_imported_task(next, next_comm, now, origin, next_prio);
+				if (task->sleeping) __wake_imported_task(task, now);
+				task->running = true;
+				task->since = now;
+			}
+		}
+	}
+	fclose(file);
+
+	if (!nr_events) {
+		fprintf(stderr, "No scheduler event in %s\n", filename);
+		return false;
+	}
+
+	/* Run on as many nominal CPUs as the trace */
+	for (nr_cpus = 0; nr_cpus <= max_cpu && nr_cpus < MAX_NR_CPUS; nr_cpus++) {
+		cpus[nr_cpus].capacity = CAPACITY_SCALE;
+		cpus[nr_cpus].core = nr_cpus;
+	}
+
+	if (!quiet) {
+		printf("- Imported %d event%s over %.3f seconds, taking %d usec%s as a tick\n",
+				nr_events, nr_events != 1 ? "s" : "", (now - origin) / 1000000.0,
+				__import_tick, __import_tick != 1 ? "s" : "");
+	}
+
+	list_for_each_entry_safe(task, tmp, &__imported_order, list) {
+		struct process *p = task->process;
+		struct io_request *rq, *rq_tmp;
+
+		if (task->running) task->ran += now - task->since;
+		list_del(&task->hash);
+		list_del(&task->list);
+
+		/* Tasks never on CPUs in the trace are dropped */
+		if (!task->ran) {
+			list_for_each_entry_safe(rq, rq_tmp, &p->__io_to_issue, list) {
+				list_del(&rq->list);
+				free(rq);
+			}
+			free(p);
+			free(task);
+			continue;
+		}
+
+		/* Number the rest in the order of arrival without gaps */
+		p->pid = ++nr_processes;
+		p->lifespan = p->__lifespan = p->burst = __import_ticks(task->ran);
+		if (!p->lifespan) p->lifespan = p->__lifespan = p->burst = 1;
+
+		/* Sleeps at the exit are not to schedule */
+		list_for_each_entry_safe(rq, rq_tmp, &p->__io_to_issue, list) {
+			if (rq->at < p->lifespan) continue;
+			list_del(&rq->list);
+			free(rq);
+		}
+
+		if (!__setup_thread(p)) return false;
+		list_add_tail(&p->list, &__forkqueue);
+
+		if (!quiet) printf("- Task %s-%d runs as process %d\n", task->comm, task->pid, p->pid);
+		__briefing_process(p);
+		free(task);
+	}
+	if (!quiet) printf("\n");
+
+	return true;
+}
+
+
+/***********************************************************************
+ * Streaming of job traces in the Standard Workload Format
+ *
+ * Each line of an SWF trace describes a job with 18 fields, in the order of
+ * the submit time. A job becomes a process forked at the submit time and
+ * run for the runtime, with a thread for each processor that it requested.
+ * The processors are scaled down to the CPUs when the traced system had more
+ * than MAX_NR_CPUS. Jobs are put into a group for each SWF group, or for each
+ * user when the group is not given, as long as groups can be declared, and
+ * run the program for their executable.
+ *
+ * The jobs are read one ahead as the simulation goes on, so only the jobs
+ * in the system are in memory however long the trace is.
+ */
+enum swf_field {
+	SWF_JOB = 0,
+	SWF_SUBMIT = 1,
+	SWF_RUNTIME = 3,
+	SWF_ALLOCATED = 4,
+	SWF_REQUESTED = 7,
+	SWF_USER = 11,
+	SWF_GROUP = 12,
+	SWF_EXECUTABLE = 13,
+	NR_SWF_FIELDS = 18,
+};
+
+static struct {
+	char *name;
+	FILE *file;
+	unsigned int tick;			/* Seconds per tick. 0 if not streaming */
+	unsigned int max_procs;		/* # of processors in the traced system */
+	struct process *next;		/* The job read ahead */
+
+	unsigned long long nr_jobs;
+	unsigned long long nr_skipped;	/* Jobs without the runtime */
+} __swf;
+
+static inline unsigned int __swf_ticks(double secs)
+{
+	return secs / __swf.tick + 0.5;
+}
+
+/**
+ * Parse the fields of the job at @line. Return false if not a job
+ */
+static bool __parse_swf_job(char *line, double fields[])
+{
+	char *s = line, *end;
+
+	if (line[0] == ';') return false;
+
+	for (int i = 0; i < NR_SWF_FIELDS; i++) {
+		fields[i] = strtod(s, &end);
+		if (end == s) return false;
+		s = end;
+	}
+	return true;
+}
+
+/**
+ * Name the group that the job with @fields belongs to
+ */
+static void __swf_group_name(double fields[], char *name)
+{
+	if (fields[SWF_GROUP] >= 0) {
+		sprintf(name, "group%d", (int)fields[SWF_GROUP]);
+	} else if (fields[SWF_USER] >= 0) {
+		sprintf(name, "user%d", (int)fields[SWF_USER]);
+	} else {
+		strcpy(name, "root");
+	}
+}
+
+/**
+ * Read the next job to run from the trace. NULL at the end of the trace
+ */
+static struct process *__read_swf_job(void)
+{
+	char line[512];
+	double fields[NR_SWF_FIELDS];
+
+	while (fgets(line, sizeof(line), __swf.file)) {
+		struct process *p;
+		struct group *g;
+		char name[32];
+		int procs;
+
+		if (!__parse_swf_job(line, fields)) continue;
+
+		if (fields[SWF_RUNTIME] <= 0) {
+			__swf.nr_skipped++;
+			continue;
+		}
+		__swf.nr_jobs++;
+
+		p = __alloc_process(fields[SWF_JOB]);
+		p->sched_class = SCHED_CLASS_FAIR;
+		p->__leader = p;
+		p->__nr_threads = 1;
+		p->__starts_at = __swf_ticks(fields[SWF_SUBMIT]);
+		p->lifespan = p->__lifespan = p->burst = __swf_ticks(fields[SWF_RUNTIME]);
+		if (!p->lifespan) p->lifespan = p->__lifespan = p->burst = 1;
+
+		__swf_group_name(fields, name);
+		p->group = (g = __find_group(name)) ? g : groups;
+
+		if (fields[SWF_EXECUTABLE] >= 0 && __nr_programs < MAX_NR_PROGRAMS) {
+			sprintf(name, "exe%d", (int)fields[SWF_EXECUTABLE]);
+			p->__program = __find_program(name);
+		}
+
+		/* Run a thread on each processor requested, or allocated */
+		procs = fields[SWF_REQUESTED] > 0 ? fields[SWF_REQUESTED] :
+				fields[SWF_ALLOCATED] > 0 ? fields[SWF_ALLOCATED] : 1;
+		if (__swf.max_procs > nr_cpus) {
+			procs = (procs * nr_cpus + __swf.max_procs - 1) / __swf.max_procs;
+		}
+		if (procs > nr_cpus) procs = nr_cpus;
+
+		while (p->__nr_threads < procs) {
+			struct process *t = __alloc_process(p->pid);
+
+			t->lifespan = t->__lifespan = t->burst = p->lifespan;
+			t->__leader = p;
+			t->__tid = p->__nr_threads++;
+			list_add_tail(&t->__sibling, &p->__threads);
+			__setup_thread(t);
+		}
+		__setup_thread(p);
+
+		return p;
+	}
+	return NULL;
+}
+
+/**
+ * Put the jobs submitted by now into the fork queue
+ */
+static void __stream_swf(void)
+{
+	while (__swf.next && __swf.next->__starts_at <= ticks) {
+		list_add_tail(&__swf.next->list, &__forkqueue);
+		__swf.next = __read_swf_job();
+	}
+}
+
+/**
+ * Let the child simulating in parallel read the trace through its own file
+ * not to move the parent along
+ */
+static void __reopen_swf(void)
+{
+	long offset = ftell(__swf.file);
+
+	__swf.file = fopen(__swf.name, "r");
+	if (!__swf.file || fseek(__swf.file, offset, SEEK_SET)) _exit(EXIT_FAILURE);
+}
+
+static bool __open_swf(char * const filename)
+{
+	char line[512];
+	double fields[NR_SWF_FIELDS];
+
+	if (!(__swf.file = fopen(filename, "r"))) {
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return false;
+	}
+	__swf.name = filename;
+
+	/* Job numbers run into millions, too many columns to indent by */
+	__trace.pid_field = true;
+
+	if (!quiet) {
+		printf("- Stream jobs from %s, taking %d second%s as a tick\n",
+				filename, __swf.tick, __swf.tick != 1 ? "s" : "");
+	}
+
+	/* Size up the system, and declare the groups in a pass over the trace */
+	while (fgets(line, sizeof(line), __swf.file)) {
+		char name[32];
+		struct group *g;
+
+		if (sscanf(line, "; MaxProcs: %u", &__swf.max_procs) == 1) continue;
+		if (!__parse_swf_job(line, fields)) continue;
+
+		__swf_group_name(fields, name);
+		if (nr_groups >= MAX_NR_GROUPS || __find_group(name)) continue;
+
+		g = groups + nr_groups;
+		g->id = nr_groups++;
+		strcpy(g->name, name);
+		g->shares = DEFAULT_SHARES;
+		g->parent = groups;
+		g->se.weight = g->shares;
+		g->se.parent = groups;
+		g->se.my_q = g;
+		INIT_HEAP_NODE(&g->se.run_node);
+
+		if (!quiet) {
+			printf("- Group %s: %d shares under %s\n", g->name, g->shares, groups->name);
+		}
+	}
+	rewind(__swf.file);
+
+	/* Run on as many nominal CPUs as the traced system up to MAX_NR_CPUS */
+	for (nr_cpus = 0; nr_cpus < __swf.max_procs && nr_cpus < MAX_NR_CPUS; nr_cpus++) {
+		cpus[nr_cpus].capacity = CAPACITY_SCALE;
+		cpus[nr_cpus].core = nr_cpus;
+	}
+	if (!nr_cpus) {
+		cpus[0].capacity = CAPACITY_SCALE;
+		cpus[0].core = 0;
+		nr_cpus = 1;
+	}
+	if (!quiet && __swf.max_procs > nr_cpus) {
+		printf("- Scale %d processors down to %d CPUs\n", __swf.max_procs, nr_cpus);
+	}
+	if (!quiet) printf("\n");
+
+	__swf.next = __read_swf_job();
+	return true;
+}
+
+
+/**
+ * Predict the lifespan of @p given that it has run for @age ticks.
+ */
+static unsigned int __predict_burst(struct process *p, unsigned int age)
+{
+	struct program *prog = __programs + p->__program;
+	unsigned int burst = 0;
+
+	if (prog->nr_runs == 0) return age + 1;
+
+	if (__predictor == PREDICTOR_AVERAGE) {
+		burst = prog->average + 0.5;
+	} else {
+		/* Quantile among the runs that lasted longer than @age */
+		unsigned int nr_runs = 0, count = 0;
+
+		for (int i = age + 1; i < HISTOGRAM_BINS; i++) {
+			nr_runs += prog->histogram[i];
+		}
+		for (int i = age + 1; i < HISTOGRAM_BINS && nr_runs; i++) {
+			count += prog->histogram[i];
+			if (count * 100 >= nr_runs * __quantile) {
+				burst = i < HISTOGRAM_BINS - 1 ? i : prog->longest;
+				break;
+			}
+		}
+		if (age >= HISTOGRAM_BINS - 1) burst = prog->longest;
+	}
+	return burst > age ? burst : age + 1;
+}
+
+/**
+ * Learn the lifespan of @p from its completed run
+ */
+static void __learn_burst(struct process *p)
+{
+	struct program *prog = __programs + p->__program;
+	unsigned int lifespan = p->__lifespan;
+
+	if (prog->nr_runs++ == 0) {
+		prog->average = lifespan;
+	} else {
+		prog->average = (prog->average + lifespan) / 2;
+	}
+	prog->histogram[lifespan < HISTOGRAM_BINS ? lifespan : HISTOGRAM_BINS - 1]++;
+	if (lifespan > prog->longest) prog->longest = lifespan;
+
+	__prediction_error += p->__predicted > lifespan ?
+			p->__predicted - lifespan : lifespan - p->__predicted;
+	__nr_predictions++;
+}
+
+/**
+ * Make the forked thread @t ready to run
+ */
+static void __fork_thread(struct process *t)
+{
+	/* Hide the lifespan from the scheduler */
+	if (__predictor != PREDICTOR_NONE) {
+		t->lifespan = UNKNOWN_LIFESPAN;
+		t->burst = __predict_burst(t, 0);
+	}
+	t->__predicted = t->burst;
+	__backlog += t->burst;
+
+	/* The periods of the process bandwidth start from the fork */
+	if (t == t->__leader && t->__bandwidth) {
+		add_timer(&t->__bandwidth->period_timer, ticks + t->__bandwidth->period);
+	}
+
+	trace_sched(fork, t->pid, t->prio, -1);
+	wake_up_process(t);
+	if (t->sched_class == SCHED_CLASS_FAIR && sched->forked) {
+		sched->forked(t);
+	}
+}
+
+/**
+ * Fork @p and its threads
+ */
+static void __fork_process(struct process *p)
+{
+	struct process *t;
+	unsigned int wait = ticks - p->__arrived_at;
+
+	p->__forked_at = ticks;
+	p->group->__nr_processes++;
+	__sched_classes[p->sched_class].nr_processes++;
+	__export.nr_forks++;
+	__print_event(EVENT_FORK, p->pid, "N");
+
+	__fork_thread(p);
+	list_for_each_entry(t, &p->__threads, __sibling) {
+		t->__forked_at = ticks;
+		__fork_thread(t);
+	}
+
+	__admission.nr_admitted++;
+	__admission.wait_ticks += wait;
+	if (wait > __admission.max_wait) __admission.max_wait = wait;
+}
+
+/**
+ * Check whether the system can take a process now. Admitting a process
+ * under the rate limit consumes a token
+ */
+static bool __admit(void)
+{
+	struct admission *a = &__admission;
+	unsigned int nr_running = 0;
+
+	switch (a->limit) {
+	case ADMIT_RUNNABLE:
+		for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+			nr_running += __sched_classes[i].nr_running;
+		}
+		return nr_running < a->value;
+	case ADMIT_RATE:
+		a->tokens += (unsigned long long)(ticks - a->refilled_at) * a->value;
+		a->refilled_at = ticks;
+		if (a->tokens > (unsigned long long)a->value * a->period) {
+			a->tokens = (unsigned long long)a->value * a->period;
+		}
+		if (a->tokens < a->period) return false;
+
+		a->tokens -= a->period;
+		return true;
+	case ADMIT_WAIT:
+		return __backlog / nr_cpus <= a->value;
+	default:
+		return true;
+	}
+}
+
+/**
+ * Turn away @p without running it, and its successors as well since they
+ * cannot run without @p. Rejected processes are kept in @__rejected as
+ * the other predecessors of the successors may refer to them.
+ */
+static LIST_HEAD(__rejected);
+
+static void __reject_process(struct process *p, bool shed)
+{
+	struct dependency *dep, *tmp;
+
+	__print_event(EVENT_ADMIT, p->pid, "%s", shed ? "S" : "R");
+	if (shed) {
+		__admission.nr_shed++;
+	} else {
+		__admission.nr_rejected++;
+	}
+	p->status = PROCESS_EXIT;
+	list_add_tail(&p->list, &__rejected);
+
+	list_for_each_entry_safe(dep, tmp, &p->__successors, list) {
+		struct process *s = dep->process;
+
+		if (s->status != PROCESS_EXIT) {
+			list_del_init(&s->list);
+			__admission.nr_arrived++;
+			__reject_process(s, false);
+		}
+		list_del(&dep->list);
+		free(dep);
+	}
+}
+
+/**
+ * Hold back @p that the system cannot take now, or turn it away
+ */
+static void __hold_back(struct process *p)
+{
+	struct admission *a = &__admission;
+	struct process *victim = p, *pos;
+
+	if (a->action == ADMIT_REJECT) {
+		__reject_process(p, false);
+		return;
+	}
+
+	__print_event(EVENT_ADMIT, p->pid, "D");
+	list_add_tail(&p->list, &a->queue);
+	if (a->action == ADMIT_DEFER || ++a->nr_queued <= a->depth) return;
+
+	/* Too many processes are held back. Shed the least important one */
+	list_for_each_entry(pos, &a->queue, list) {
+		if (pos->prio <= victim->prio) victim = pos;
+	}
+	list_del_init(&victim->list);
+	a->nr_queued--;
+	__reject_process(victim, true);
+}
+
+/**
+ * Pick the process held back to admit next. Processes are admitted in the
+ * order of arrivals when deferred, and in the order of priority when shed.
+ */
+static struct process *__pick_held_back(void)
+{
+	struct admission *a = &__admission;
+	struct process *next = NULL, *pos;
+
+	list_for_each_entry(pos, &a->queue, list) {
+		if (!next || pos->prio > next->prio) next = pos;
+		if (a->action == ADMIT_DEFER) break;
+	}
+	return next;
+}
+
+/**
+ * Fork the processes due to fork now, if the system admits them
+ */
+static int __fork_on_schedule()
+{
+	int nr_forked = 0;
+	struct process *p, *tmp;
+
+	if (__swf.file) __stream_swf();
+
+	while ((p = __pick_held_back()) && __admit()) {
+		list_del_init(&p->list);
+		if (__admission.action == ADMIT_SHED) __admission.nr_queued--;
+		__fork_process(p);
+		nr_forked++;
+	}
+
+	list_for_each_entry_safe(p, tmp, &__forkqueue, list) {
+		if (p->__starts_at > ticks) continue;
+
+		list_del_init(&p->list);
+		p->__arrived_at = ticks;
+		__admission.nr_arrived++;
+
+		/* New arrivals do not get ahead of the ones held back */
+		if (list_empty(&__admission.queue) && __admit()) {
+			__fork_process(p);
+			nr_forked++;
+		} else {
+			__hold_back(p);
+		}
+	}
+	return nr_forked;
+}
+
+/**
+ * Turnaround and throttled time of the exited processes that were throttled
+ */
+static unsigned int __nr_throttled_exited = 0;
+static unsigned long long __throttled_turnaround = 0;
+static unsigned long long __throttled_ticks = 0;
+
+/**
+ * Exit the thread @t, and the process as well if it is the last thread
+ */
+static void __exit_process(struct process *t)
+{
+	struct process *p = t->__leader;
+	struct dependency *dep, *tmp;
+
+	/* Make sure the thread is not attached to some list head */
+	assert(list_empty(&t->list));
+
+	/* Make sure the thread is not holding any resource */
+	assert(list_empty(&t->__resources_holding));
+
+	/* Make sure there is no pending resource to acquire */
+	assert(list_empty(&t->__resources_to_acquire));
+
+	/* Nor pending I/O to issue or priority to set */
+	assert(list_empty(&t->__io_to_issue));
+	assert(list_empty(&t->__prio_to_set));
+	assert(list_empty(&t->__barriers_to_reach));
+	assert(list_empty(&t->__messages_to_pass));
+
+	/* The behavior is all done as well */
+	if (t->__behavior) {
+		assert(t->__behavior->ip == t->__behavior->nr_words);
+		free(t->__behavior->code);
+		free(t->__behavior);
+		t->__behavior = NULL;
+	}
+
+	if (t->sched_class == SCHED_CLASS_FAIR && sched->exiting) sched->exiting(t);
+	del_timer(&t->__watchdog);
+
+	trace_sched(exit, t->pid, t->prio, -1);
+
+	__sched_classes[t->sched_class].nr_running--;
+	__backlog -= t->burst - t->age;
+
+	if (__predictor != PREDICTOR_NONE) __learn_burst(t);
+
+	/* The process lives on while it has threads alive */
+	/* Threads throttled together delay the process only once */
+	if (t != p && t->__throttled_ticks > p->__throttled_ticks) {
+		p->__throttled_ticks = t->__throttled_ticks;
+	}
+	if (--p->__nr_threads) {
+		if (t != p) {
+			list_del(&t->__sibling);
+			free(t);
+		}
+		return;
+	}
+
+	if (p->__bandwidth) del_timer(&p->__bandwidth->period_timer);
+
+	__sched_classes[p->sched_class].nr_exited++;
+	__sched_classes[p->sched_class].turnaround += ticks - p->__forked_at;
+
+	p->group->__nr_exited++;
+	p->group->__turnaround += ticks - p->__forked_at;
+
+	/* @__first_run_at is valid only if the process has ever run */
+	if (p->__has_run) {
+		__sched_classes[p->sched_class].response += p->__first_run_at - p->__forked_at;
+
+		p->group->__nr_responses++;
+		p->group->__response += p->__first_run_at - p->__forked_at;
+	}
+
+	__admission.turnaround += ticks - p->__arrived_at;
+
+	/* Let the successors go to the fork queue once all predecessors exit */
+	list_for_each_entry_safe(dep, tmp, &p->__successors, list) {
+		if (--dep->process->__nr_predecessors == 0 &&
+				dep->process->status != PROCESS_EXIT) {
+			list_move_tail(&dep->process->list, &__forkqueue);
+		}
+		list_del(&dep->list);
+		free(dep);
+	}
+
+	if (p->__throttled_ticks) {
+		__nr_throttled_exited++;
+		__throttled_turnaround += ticks - p->__forked_at;
+		__throttled_ticks += p->__throttled_ticks;
+	}
+
+	__export.nr_exits++;
+	__print_event(EVENT_EXIT, p->pid, "X");
+
+	if (t != p) {
+		list_del(&t->__sibling);
+		free(t);
+	}
+	free(p);
+}
+
+
+/**
+ * Check whether @p is running on a CPU
+ */
+static bool __is_running(struct process *p)
+{
+	for (int i = 0; i < nr_cpus; i++) {
+		if (cpus[i].current == p) return true;
+	}
+	return false;
+}
+
+/**
+ * Check whether @current should spin on @r held by others rather than
+ * sleeping on it
+ */
+static bool __should_spin(struct resource *r)
+{
+	if (nr_cpus <= 1) return false;
+
+	switch (r->type) {
+	case RESOURCE_SPIN:
+		return true;
+	case RESOURCE_ADAPTIVE:
+		return __is_running(r->owner);
+	default:
+		return false;
+	}
+}
+
+static bool __is_holding(struct process *t, unsigned int resource_id)
+{
+	struct resource_schedule *rs;
+
+	list_for_each_entry(rs, &t->__resources_holding, list) {
+		if (rs->resource_id == resource_id) return true;
+	}
+	return false;
+}
+
+/**
+ * Find a thread other than @t in the process of @t, which holds resource
+ * @resource_id
+ */
+static struct process *__find_holder(struct process *t, unsigned int resource_id)
+{
+	struct process *p = t->__leader;
+	struct process *h;
+
+	if (p != t && __is_holding(p, resource_id)) return p;
+
+	list_for_each_entry(h, &p->__threads, __sibling) {
+		if (h != t && __is_holding(h, resource_id)) return h;
+	}
+
+	assert(0 && "No sibling holding the resource");
+	return NULL;
+}
+
+/**
+ * Process resource acqutision. When @current is to spin on a resource held
+ * by others, @spin_on is set to the resource id.
+ */
+static bool __run_current_acquire(int *spin_on)
+{
+	struct resource_schedule *rs, *tmp;
+
+	list_for_each_entry_safe(rs, tmp, &current->__resources_to_acquire, list) {
+		if (rs->at == current->age) {
+			struct resource *r = resources + rs->resource_id;
+			assert(sched->acquire && "scheduler.acquire() not implemented");
+
+			/*
+			 * Share the resource that a sibling thread is holding. This
+			 * deliberately bypasses sched->acquire(): the policies track
+			 * a single owner per resource and would queue the thread
+			 * behind its own process. The share leaves the owner, the
+			 * wait queue, and the priorities untouched, so the policy
+			 * has nothing to account; it sees the release only when the
+			 * last holder lets the resource go.
+			 */
+			if (r->owner && r->owner != current &&
+					r->owner->__leader == current->__leader) {
+				trace_sched(acquire, current->pid, current->prio, rs->resource_id);
+				r->__nr_holders++;
+				list_move_tail(&rs->list, &current->__resources_holding);
+
+				__print_event(EVENT_ACQUIRE, current->pid, "+%d", rs->resource_id);
+				continue;
+			}
+
+			/* Keep spinning without bothering the scheduler */
+			if (r->owner && r->owner != current && __should_spin(r)) {
+				r->__spin_ticks++;
+				*spin_on = rs->resource_id;
+				return false;
+			}
+
+			/* Callback to acquire the resource */
+			if (sched->acquire(rs->resource_id)) {
+				trace_sched(acquire, current->pid, current->prio, rs->resource_id);
+				r->__nr_holders = 1;
+				list_move_tail(&rs->list, &current->__resources_holding);
+
+				__print_event(EVENT_ACQUIRE, current->pid, "+%d", rs->resource_id);
+			} else {
+				trace_sched(acquire_fail, current->pid, current->prio, rs->resource_id);
+				r->__nr_sleeps++;
+				r->__nr_waiters++;
+				__nr_blocked++;
+				__sched_classes[current->sched_class].nr_running--;
+				__watch_blocked(current, rs->resource_id);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void __complete_io(struct timer *timer);
+
+/**
+ * Start serving the requests queued on @dev while it has room
+ */
+static void __serve_io(struct device *dev)
+{
+	while (dev->nr_serving < dev->parallelism && !list_empty(&dev->queue)) {
+		struct io_request *rq, *next = NULL;
+
+		list_for_each_entry(rq, &dev->queue, list) {
+			if (!next ||
+					(dev->discipline == IO_SJF && rq->duration < next->duration) ||
+					(dev->discipline == IO_PRIO && rq->process->prio > next->process->prio)) {
+				next = rq;
+			}
+		}
+		list_del_init(&next->list);
+
+		if (dev->nr_serving++ == 0) dev->__busy_since = ticks;
+		dev->__wait_ticks += ticks - next->queued_at;
+
+		timer_setup(&next->timer, __complete_io);
+		add_timer(&next->timer, ticks + next->duration);
+	}
+}
+
+/**
+ * The request arrives at the device in the tick after it is issued
+ */
+static void __submit_io(struct timer *timer)
+{
+	struct io_request *rq = container_of(timer, struct io_request, timer);
+
+	rq->queued_at = ticks;
+	list_add_tail(&rq->list, &rq->device->queue);
+
+	__serve_io(rq->device);
+}
+
+/**
+ * The device completed the request. Wake up the process issued it
+ */
+static void __complete_io(struct timer *timer)
+{
+	struct io_request *rq = container_of(timer, struct io_request, timer);
+	struct device *dev = rq->device;
+
+	dev->__nr_requests++;
+	dev->__service_ticks += rq->duration;
+	if (--dev->nr_serving == 0) dev->__busy_ticks += ticks - dev->__busy_since;
+
+	__nr_sleeping--;
+	__nr_io_waiting--;
+	wake_up_process(rq->process);
+	free(rq);
+
+	__serve_io(dev);
+}
+
+/**
+ * The process slept long enough
+ */
+static void __complete_sleep(struct timer *timer)
+{
+	struct io_request *rq = container_of(timer, struct io_request, timer);
+
+	__nr_sleeping--;
+	wake_up_process(rq->process);
+	free(rq);
+}
+
+/**
+ * Issue the I/O request or sleep scheduled at the current age. @current
+ * spends this tick issuing the request, leaves the CPU, and sleeps until the
+ * device completes the request or the sleep duration passes.
+ */
+static bool __run_current_io(void)
+{
+	struct io_request *rq;
+
+	list_for_each_entry(rq, &current->__io_to_issue, list) {
+		if (rq->at != current->age) continue;
+
+		list_del_init(&rq->list);
+
+		current->status = PROCESS_WAIT;
+		__sched_classes[current->sched_class].nr_running--;
+		__nr_sleeping++;
+
+		if (!rq->device) {
+			timer_setup(&rq->timer, __complete_sleep);
+			add_timer(&rq->timer, ticks + 1 + rq->duration);
+
+			__print_event(EVENT_IO, current->pid, "Z");
+			return true;
+		}
+
+		__nr_io_waiting++;
+		timer_setup(&rq->timer, __submit_io);
+		add_timer(&rq->timer, ticks + 1);
+
+		__print_event(EVENT_IO, current->pid, "!%d", rq->device->id);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Change the priority of @p to @prio. A process boosted by the priority
+ * inheritance keeps the boosted priority until it releases the resource,
+ * and gets back to the new priority then.
+ */
+static void __set_prio(struct process *p, unsigned int prio)
+{
+	unsigned int old_prio = p->prio;
+
+	if (p->prio == p->prio_orig || prio > p->prio) p->prio = prio;
+	p->prio_orig = prio;
+
+	__print_event(EVENT_PRIO, p->pid, "^%d", prio);
+
+	if (p->prio != old_prio && p->sched_class == SCHED_CLASS_FAIR && sched->prio_changed) {
+		sched->prio_changed(p, old_prio);
+	}
+}
+
+/**
+ * Perform the priority changes scheduled at the current age
+ */
+static void __run_current_setprio(void)
+{
+	struct prio_schedule *ps, *tmp;
+
+	list_for_each_entry_safe(ps, tmp, &current->__prio_to_set, list) {
+		if (ps->at > current->age) break;
+
+		__set_prio(current, ps->prio);
+
+		list_del(&ps->list);
+		free(ps);
+	}
+}
+
+/**
+ * Arrive at the barriers scheduled at the current age in turn. @current waits
+ * at a barrier unless it is the last one to arrive, in which case it releases
+ * all the waiters at once and goes on to the next. Return true if @current is
+ * to wait; it comes back for the rest when released.
+ */
+static bool __run_current_barrier(void)
+{
+	struct barrier_schedule *bs, *tmp, *w, *w_tmp;
+	struct barrier *b;
+
+	/* Arrive at all the barriers due at the current age unless waiting at one */
+	list_for_each_entry_safe(bs, tmp, &current->__barriers_to_reach, list) {
+		if (bs->at != current->age) continue;
+
+		b = __barriers + bs->barrier_id;
+		__print_event(EVENT_SYNC, current->pid, "|%d", bs->barrier_id);
+
+		if (++b->nr_arrived < b->count) {
+			bs->arrived_at = ticks;
+			list_move_tail(&bs->list, &b->waiters);
+
+			current->status = PROCESS_WAIT;
+			__sched_classes[current->sched_class].nr_running--;
+			return true;
+		}
+
+		/* Here comes the last one. Release everyone */
+		list_for_each_entry_safe(w, w_tmp, &b->waiters, list) {
+			unsigned int stall = ticks - w->arrived_at;
+
+			b->nr_waits++;
+			b->stall_ticks += stall;
+			if (stall > b->max_stall) b->max_stall = stall;
+
+			wake_up_process(w->process);
+
+			list_del(&w->list);
+			free(w);
+		}
+		list_del(&bs->list);
+		free(bs);
+
+		b->nr_arrived = 0;
+		b->nr_rounds++;
+	}
+	return false;
+}
+
+/**
+ * Account the change of the number of messages in @c by @delta
+ */
+static void __update_channel(struct channel *c, int delta)
+{
+	c->occupancy += (unsigned long long)c->nr_messages * (ticks - c->changed_at);
+	c->changed_at = ticks;
+	c->nr_messages += delta;
+}
+
+/**
+ * Wake up the first waiter in @waitqueue of @c, whose message is passed
+ */
+static void __wake_up_messenger(struct channel *c, struct list_head *waitqueue)
+{
+	struct message_schedule *ms =
+			list_first_entry(waitqueue, struct message_schedule, list);
+
+	if (ms->send) {
+		c->send_ticks += ticks - ms->queued_at;
+	} else {
+		c->recv_ticks += ticks - ms->queued_at;
+	}
+	wake_up_process(ms->process);
+
+	list_del(&ms->list);
+	free(ms);
+}
+
+/**
+ * Send or receive the messages scheduled at the current age in turn.
+ * @current waits in the channel if the channel is full to send or empty to
+ * receive. Return true if @current is to wait; it comes back for the rest
+ * when woken up.
+ */
+static bool __run_current_message(void)
+{
+	struct message_schedule *ms, *tmp;
+	struct channel *c;
+
+	/* Pass all the messages due at the current age unless waiting for one */
+	list_for_each_entry_safe(ms, tmp, &current->__messages_to_pass, list) {
+		if (ms->at != current->age) continue;
+
+		c = __channels + ms->channel_id;
+
+		if (ms->send) {
+			__print_event(EVENT_SYNC, current->pid, ">%d", ms->channel_id);
+
+			if (!list_empty(&c->receivers)) {
+				/* Hand over to the waiting receiver */
+				__wake_up_messenger(c, &c->receivers);
+				c->nr_passed++;
+			} else if (c->nr_messages < c->capacity) {
+				__update_channel(c, 1);
+			} else {
+				goto wait;
+			}
+		} else {
+			__print_event(EVENT_SYNC, current->pid, "<%d", ms->channel_id);
+
+			if (c->nr_messages) {
+				__update_channel(c, -1);
+				c->nr_passed++;
+
+				/* Make a room for the waiting sender */
+				if (!list_empty(&c->senders)) {
+					__wake_up_messenger(c, &c->senders);
+					__update_channel(c, 1);
+				}
+			} else if (!list_empty(&c->senders)) {
+				/* Take over from the waiting sender without buffering */
+				__wake_up_messenger(c, &c->senders);
+				c->nr_passed++;
+			} else {
+				goto wait;
+			}
+		}
+
+		list_del(&ms->list);
+		free(ms);
+	}
+	return false;
+
+wait:
+	ms->queued_at = ticks;
+	list_move_tail(&ms->list, ms->send ? &c->senders : &c->receivers);
+
+	current->status = PROCESS_WAIT;
+	__sched_classes[current->sched_class].nr_running--;
+	return true;
+}
+
+/**
+ * Hand the ownership of @r over to the sibling thread @to. The priority
+ * boost that the owner inherited for @r goes along with the ownership so
+ * that the waiters keep pushing the thread that will release it.
+ */
+static void __hand_over_resource(struct resource *r, struct process *to)
+{
+	struct process *from = r->owner;
+	unsigned int boost = from->prio;
+
+	if (boost != from->prio_orig) {
+		from->prio = from->prio_orig;
+
+		if (boost > to->prio) {
+			unsigned int old_prio = to->prio;
+
+			to->prio = boost;
+			if (to->sched_class == SCHED_CLASS_FAIR && sched->prio_changed) {
+				sched->prio_changed(to, old_prio);
+			}
+		}
+	}
+	r->owner = to;
+}
+
+/**
+ * Release the resource that @current holds as @rs
+ */
+static void __release_resource(struct resource_schedule *rs)
+{
+	struct resource *r = resources + rs->resource_id;
+	assert(sched->release && "scheduler.release() not implemented");
+
+	trace_sched(release, current->pid, current->prio, rs->resource_id);
+	if (r->__nr_holders > 1) {
+		/* Sibling threads still hold it. Hand it over if owning */
+		r->__nr_holders--;
+		if (r->owner == current) {
+			__hand_over_resource(r, __find_holder(current, rs->resource_id));
+		}
+	} else {
+		/* Callback the release() */
+		sched->release(rs->resource_id);
+	}
+
+	__print_event(EVENT_RELEASE, current->pid, "-%d", rs->resource_id);
+
+	list_del(&rs->list);
+	free(rs);
+}
+
+/**
+ * Process resource release
+ */
+static void __run_current_release()
+{
+	struct resource_schedule *rs, *tmp;
+
+	list_for_each_entry_safe(rs, tmp, &current->__resources_holding, list) {
+		/* The behavior releases the ones it acquired by itself */
+		if (rs->duration == HOLD_UNTIL_RELEASE) continue;
+
+		if (--rs->duration == 0) __release_resource(rs);
+	}
+}
+
+/**
+ * Run the behavior of @current up to the next compute. Acquisitions and I/O
+ * are scheduled at the current age, and are made along with the scheduled ones
+ */
+static void __run_current_behavior(void)
+{
+	struct behavior *b = current->__behavior;
+
+	if (!b) return;
+
+	while (!b->computing && b->ip < b->nr_words) {
+		unsigned int insn = b->code[b->ip++];
+		unsigned int operand = BEHAVIOR_OPERAND(insn);
+
+		switch (BEHAVIOR_OP(insn)) {
+		case OP_COMPUTE:
+			b->computing = operand;
+			break;
+		case OP_ACQUIRE: {
+			struct resource_schedule *rs = malloc(sizeof(*rs));
+
+			rs->resource_id = operand;
+			rs->at = current->age;
+			rs->duration = HOLD_UNTIL_RELEASE;
+			list_add_tail(&rs->list, &current->__resources_to_acquire);
+			break;
+		}
+		case OP_RELEASE: {
+			struct resource_schedule *rs;
+
+			list_for_each_entry(rs, &current->__resources_holding, list) {
+				if (rs->resource_id == operand &&
+						rs->duration == HOLD_UNTIL_RELEASE) break;
+			}
+			assert(&rs->list != &current->__resources_holding);
+			__release_resource(rs);
+			break;
+		}
+		case OP_SLEEP:
+		case OP_IO: {
+			struct io_request *rq = malloc(sizeof(*rq));
+
+			rq->at = current->age;
+			rq->duration = operand;
+			rq->device = BEHAVIOR_OP(insn) == OP_IO ? __devices + b->code[b->ip++] : NULL;
+			rq->process = current;
+			list_add_tail(&rq->list, &current->__io_to_issue);
+			break;
+		}
+		case OP_LOOP:
+			b->loops[b->nr_loops++] = operand;
+			break;
+		case OP_ENDLOOP:
+			if (--b->loops[b->nr_loops - 1]) {
+				b->ip -= operand;
+			} else {
+				b->nr_loops--;
+			}
+			break;
+		}
+	}
+}
+
+
+/**
+ * Make @p ready to run
+ */
+void wake_up_process(struct process *p)
+{
+	struct sched_class *class = __sched_classes + p->sched_class;
+
+	class->nr_running++;
+	class->enqueue(p, false);
+
+	if (p->__blocked_on >= 0) {
+		resources[p->__blocked_on].__nr_waiters--;
+		__nr_blocked--;
+	}
+	__watch_woken(p);
+}
+
+/**
+ * Queue management for the scheduling classes. @head is true when putting
+ * back the process that was running, which should go in front of others.
+ */
+static void __fair_enqueue(struct process *p, bool head)
+{
+	p->status = PROCESS_READY;
+	if (head) {
+		list_add(&p->list, &readyqueue);
+	} else {
+		list_add_tail(&p->list, &readyqueue);
+	}
+}
+
+static struct process *__fair_pick_next(void)
+{
+	return sched->schedule();
+}
+
+static void __rt_enqueue(struct process *p, bool head)
+{
+	p->status = PROCESS_READY;
+	p->__rt_prio = p->prio < MAX_RT_PRIO ? p->prio : MAX_RT_PRIO - 1;
+
+	if (head) {
+		list_add(&p->list, __rt_queues + p->__rt_prio);
+	} else {
+		list_add_tail(&p->list, __rt_queues + p->__rt_prio);
+	}
+	__rt_bitmap[p->__rt_prio / 64] |= 1ULL << (p->__rt_prio % 64);
+}
+
+static struct process *__rt_pick_next(void)
+{
+	for (int i = sizeof(__rt_bitmap) / sizeof(*__rt_bitmap) - 1; i >= 0; i--) {
+		struct process *next;
+		unsigned int prio;
+
+		if (!__rt_bitmap[i]) continue;
+
+		/* The highest priority level with processes */
+		prio = i * 64 + 63 - __builtin_clzll(__rt_bitmap[i]);
+		next = list_first_entry(__rt_queues + prio, struct process, list);
+
+		list_del_init(&next->list);
+		if (list_empty(__rt_queues + prio)) {
+			__rt_bitmap[i] &= ~(1ULL << (prio % 64));
+		}
+		return next;
+	}
+	return NULL;
+}
+
+static void __idle_enqueue(struct process *p, bool head)
+{
+	p->status = PROCESS_READY;
+	if (head) {
+		list_add(&p->list, &__idlequeue);
+	} else {
+		list_add_tail(&p->list, &__idlequeue);
+	}
+}
+
+static struct process *__idle_pick_next(void)
+{
+	struct process *next = list_first_entry_or_null(&__idlequeue, struct process, list);
+
+	if (next) list_del_init(&next->list);
+	return next;
+}
+
+static struct sched_class __sched_classes[NR_SCHED_CLASSES] = {
+	[SCHED_CLASS_RT] = {
+		.name = "rt",
+		.enqueue = __rt_enqueue,
+		.pick_next = __rt_pick_next,
+	},
+	[SCHED_CLASS_FAIR] = {
+		.name = "fair",
+		.enqueue = __fair_enqueue,
+		.pick_next = __fair_pick_next,
+	},
+	[SCHED_CLASS_IDLE] = {
+		.name = "idle",
+		.enqueue = __idle_enqueue,
+		.pick_next = __idle_pick_next,
+	},
+};
+
+/**
+ * Pick the next process to run from the highest scheduling class that has
+ * a process to run. The scheduler takes care of @current in the fair class,
+ * whereas the framework puts back @current of the other classes.
+ */
+static struct process *__pick_next_process(void)
+{
+	struct process *next = NULL;
+
+	if (current && current->sched_class != SCHED_CLASS_FAIR) {
+		if (current->status == PROCESS_RUNNING && current->age < current->lifespan) {
+			__sched_classes[current->sched_class].enqueue(current, true);
+		}
+		current = NULL;
+	}
+
+	for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+		struct sched_class *class = __sched_classes + i;
+
+		if (!class->nr_running) continue;
+
+		next = class->pick_next();
+		if (i == SCHED_CLASS_FAIR) current = NULL;
+		if (next) break;
+	}
+
+	/* The fair @current is preempted by a process in the higher class */
+	if (current && current->status == PROCESS_RUNNING &&
+			current->age < current->lifespan) {
+		__fair_enqueue(current, true);
+	}
+
+	return next;
+}
+
+/**
+ * Refill the quota of the bandwidth, and wake up the processes throttled
+ */
+static void __refill_bandwidth(struct timer *timer)
+{
+	struct bandwidth *bw = container_of(timer, struct bandwidth, period_timer);
+	struct process *p, *tmp;
+
+	bw->runtime = bw->quota;
+
+	list_for_each_entry_safe(p, tmp, &bw->throttled, list) {
+		list_del_init(&p->list);
+
+		p->__throttled_ticks += ticks - p->__throttled_at;
+		bw->throttled_ticks += ticks - p->__throttled_at;
+		__nr_throttled--;
+
+		wake_up_process(p);
+	}
+
+	add_timer(timer, timer->expires + bw->period);
+}
+
+/**
+ * Find the bandwidth limiting @p that has no quota left in this period
+ */
+static struct bandwidth *__exhausted_bandwidth(struct process *p)
+{
+	if (p->__bandwidth && !p->__bandwidth->runtime) return p->__bandwidth;
+
+	for (struct group *g = p->group; g; g = g->parent) {
+		if (g->__bandwidth && !g->__bandwidth->runtime) return g->__bandwidth;
+	}
+	return NULL;
+}
+
+/**
+ * Park @p outside the ready queue until @bw is refilled
+ */
+static void __throttle_process(struct process *p, struct bandwidth *bw)
+{
+	p->status = PROCESS_THROTTLED;
+	p->__throttled_at = ticks;
+	list_add_tail(&p->list, &bw->throttled);
+
+	bw->nr_throttled++;
+	__nr_throttled++;
+	__sched_classes[p->sched_class].nr_running--;
+
+	__print_event(EVENT_THROTTLE, p->pid, "T");
+}
+
+/**
+ * Account a tick that @current occupied @cpu
+ */
+static void __account_busy_tick(struct cpu *cpu)
+{
+	cpu->__busy_ticks++;
+	current->__leader->__busy_ticks++;
+	current->group->__busy_ticks++;
+}
+
+/**
+ * Charge a tick to the quota of the bandwidths limiting @p, or give the
+ * tick back when @nr_ticks is -1
+ */
+static void __charge_bandwidth(struct process *p, int nr_ticks)
+{
+	if (p->__bandwidth) p->__bandwidth->runtime -= nr_ticks;
+
+	for (struct group *g = p->group; g; g = g->parent) {
+		if (g->__bandwidth) g->__bandwidth->runtime -= nr_ticks;
+	}
+}
+
+/**
+ * Work done by @cpu in a tick while @nr_busy threads are busy on its core
+ */
+static inline unsigned int __cpu_throughput(struct cpu *cpu, unsigned int nr_busy)
+{
+	return cpu->capacity * (nr_busy > 1 ? smt_rate : CAPACITY_SCALE);
+}
+
+/**
+ * Run @current on @cpu for a tick
+ */
+static void __run_current(struct cpu *cpu)
+{
+	int spin_on = -1;
+
+	/* Execute the current process */
+	current->status = PROCESS_RUNNING;
+
+	/* Ensure that @current is detached from any list */
+	assert(list_empty(&current->list));
+
+	/* The process responds when any of its threads runs first */
+	if (!current->__leader->__has_run) {
+		struct process *p = current->__leader;
+
+		p->__has_run = true;
+		p->__first_run_at = ticks;
+
+		__monitor.nr_responses++;
+		__monitor.response += ticks - p->__forked_at;
+	}
+	__monitor.busy++;
+
+	__watch_running(current);
+
+	/* Run the behavior up to the first compute */
+	__run_current_behavior();
+
+	/* Change the priority as scheduled */
+	__run_current_setprio();
+
+	/**
+	 * Issue the scheduled I/O, wait for the others at the scheduled barrier,
+	 * and pass the scheduled message. The tick charged to the bandwidths at
+	 * the pick is given back when @current leaves the CPU for them.
+	 */
+	if (__run_current_io() || __run_current_barrier() || __run_current_message()) {
+		__charge_bandwidth(current, -1);
+		return;
+	}
+
+	/* Try acquiring scheduled resources */
+	if (!__run_current_acquire(&spin_on)) {
+		/* Spinning on a resource keeps the CPU busy without a progress */
+		if (spin_on >= 0) {
+			__print_event(EVENT_SPIN, current->pid, "~%d", spin_on);
+			__account_busy_tick(cpu);
+			cpu->__spin_ticks++;
+			return;
+		}
+
+		/**
+		 * The current is blocked while acquiring resource(s).
+		 * In this case, @current could not make a progress in this tick
+		 */
+		__print_event(EVENT_BLOCK, current->pid, "=");
+		__monitor.blocked++;
+		__charge_bandwidth(current, -1);
+
+		/* Thus, it is not get aged nor unable to perform releases */
+		return;
+	}
+
+	/* Succesfully acquired all the resources to make a progress! */
+	if (current->__tid) {
+		if (nr_cpus <= 1) {
+			__print_event(EVENT_RUN, current->pid, "%d.%d", current->pid, current->__tid);
+		} else {
+			__print_event(EVENT_RUN, current->pid, "%d.%d@%d",
+					current->pid, current->__tid, cpu->id);
+		}
+	} else if (nr_cpus <= 1) {
+		__print_event(EVENT_RUN, current->pid, "%d", current->pid);
+	} else {
+		__print_event(EVENT_RUN, current->pid, "%d@%d", current->pid, cpu->id);
+	}
+	__account_busy_tick(cpu);
+	if (__nr_busy_threads[cpu->core] > 1) cpu->__smt_ticks++;
+
+	/**
+	 * So, it ages by the amount of work that @cpu can do in a tick. A slow
+	 * CPU or a CPU sharing its core with busy siblings takes several ticks
+	 * to age the process by one, whereas a fast CPU may age the process more
+	 * than once in a tick.
+	 */
+	current->__progress += __cpu_throughput(cpu, __nr_busy_threads[cpu->core]);
+	while (current->__progress >= WORK_PER_AGE) {
+		current->__progress -= WORK_PER_AGE;
+		current->age++;
+		__backlog--;
+
+		/* And performs scheduled releases */
+		__run_current_release();
+
+		/* Go on with the behavior when a compute is done */
+		if (current->__behavior) {
+			current->__behavior->computing--;
+			__run_current_behavior();
+		}
+
+		if (current->age == current->__lifespan) {
+			/* The lifespan is now known to everyone */
+			current->lifespan = current->__lifespan;
+			current->__progress = 0;
+			break;
+		}
+
+		/* Change the priority at the new age */
+		__run_current_setprio();
+
+		/* Predict again if it runs longer than expected */
+		if (current->age == current->burst) {
+			current->burst = __predict_burst(current, current->age);
+			__backlog += current->burst - current->age;
+		}
+
+		/* Issue I/O and acquire resources scheduled at the new age before going further */
+		if (current->__progress < WORK_PER_AGE) break;
+
+		if (__run_current_io() || __run_current_barrier() ||
+				__run_current_message()) {
+			current->__progress = 0;
+			break;
+		}
+		if (!__run_current_acquire(&spin_on)) {
+			/* Account as the first age does. The tick is already busy */
+			if (spin_on >= 0) {
+				__print_event(EVENT_SPIN, current->pid, "~%d", spin_on);
+				cpu->__spin_ticks++;
+			} else {
+				__print_event(EVENT_BLOCK, current->pid, "=");
+				__monitor.blocked++;
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * Pick the next process, throttling the picked ones that used up their
+ * bandwidth and picking again. The tick is charged to the quota right away
+ * so that the threads picked for the other CPUs in this tick see it used.
+ */
+static struct process *__pick_next_runnable(void)
+{
+	struct process *next;
+	struct bandwidth *bw;
+
+	while ((next = __pick_next_process()) && (bw = __exhausted_bandwidth(next))) {
+		__throttle_process(next, bw);
+		current = NULL;
+	}
+	if (next) __charge_bandwidth(next, 1);
+	return next;
+}
+
+/**
+ * Ask the scheduler to pick the next process to run on @cpu
+ */
+static void __schedule_cpu(struct cpu *cpu)
+{
+	struct process *prev = cpu->current;
+
+	current = prev;
+	cpu->current = __pick_next_runnable();
+
+	/* If the CPU ran a process in the previous tick, */
+	if (prev) {
+		/* Update the process status */
+		if (prev->status == PROCESS_RUNNING) {
+			prev->status = PROCESS_READY;
+		}
+
+		/* Decommission it if completed */
+		if (prev->age == prev->lifespan) {
+			bool released = (prev->__leader->__nr_threads == 1 &&
+					!list_empty(&prev->__leader->__successors)) ||
+					!list_empty(&__admission.queue);
+
+			prev->status = PROCESS_EXIT;
+			__exit_process(prev);
+
+			/**
+			 * Fork the successors and the processes held back for admission
+			 * right away, and run one if nothing to run
+			 */
+			if (released && __fork_on_schedule() && !cpu->current) {
+				current = NULL;
+				cpu->current = __pick_next_runnable();
+			}
+		}
+	}
+
+	if (cpu->current) {
+		trace_sched(schedule, cpu->current->pid, cpu->current->prio, -1);
+	}
+}
+
+/**
+ * Pick an idle CPU to schedule next. CPUs on idle cores are preferred over
+ * the ones whose siblings are busy, and faster CPUs over slower ones.
+ */
+static struct cpu *__pick_idle_cpu(bool scheduled[])
+{
+	struct cpu *next = NULL;
+
+	for (int i = 0; i < nr_cpus; i++) {
+		struct cpu *c = __cpus_by_capacity[i];
+
+		if (scheduled[c->id]) continue;
+
+		if (__nr_busy_threads[c->core] == 0) return c;
+		if (!next) next = c;
+	}
+	return next;
+}
+
+/**
+ * Migrate processes to idle CPUs where they run faster. This moves the
+ * processes on slow CPUs to faster ones, and spreads the processes sharing
+ * a core with busy siblings over idle cores.
+ */
+static void __balance_cpus(void)
+{
+	for (int n = 0; n < nr_cpus; n++) {
+		struct cpu *src = NULL, *dst = NULL;
+		unsigned int src_work = 0, dst_work = 0;
+
+		/* Find the busy CPU doing the least work */
+		for (int i = 0; i < nr_cpus; i++) {
+			struct cpu *c = __cpus_by_capacity[i];
+			unsigned int work;
+
+			if (!c->current) continue;
+
+			work = __cpu_throughput(c, __nr_busy_threads[c->core]);
+			if (!src || work < src_work) {
+				src = c;
+				src_work = work;
+			}
+		}
+		if (!src) return;
+
+		/* And the idle CPU where the process would do the most work */
+		for (int i = 0; i < nr_cpus; i++) {
+			struct cpu *c = __cpus_by_capacity[i];
+			unsigned int work;
+
+			if (c->current) continue;
+
+			work = __cpu_throughput(c, __nr_busy_threads[c->core] +
+					(c->core == src->core ? 0 : 1));
+			if (work > dst_work) {
+				dst = c;
+				dst_work = work;
+			}
+		}
+		if (!dst || dst_work <= src_work) return;
+
+		dst->current = src->current;
+		src->current = NULL;
+		__nr_busy_threads[src->core]--;
+		__nr_busy_threads[dst->core]++;
+		dst->__migrations++;
+	}
+}
+
+
+/**
+ * Evaluate the metrics of the window that just ended
+ */
+static double __evaluate_metric(enum monitor_metric metric)
+{
+	switch (metric) {
+	case METRIC_RUNQUEUE:
+		return (double)__monitor.runqueue / __monitor.window;
+	case METRIC_BLOCKED:
+		return __monitor.busy ? __monitor.blocked * 100.0 / __monitor.busy : 0;
+	case METRIC_RESPONSE:
+		return __monitor.nr_responses ?
+				(double)__monitor.response / __monitor.nr_responses : 0;
+	default:
+		assert(0);
+	}
+	return 0;
+}
+
+/**
+ * Switch the scheduler according to the first rule that the metrics meet.
+ * The outgoing scheduler hands the processes in its own data structures over
+ * to the ready queue in finalize(), and the incoming one takes them from
+ * there after initialize().
+ */
+static void __switch_scheduler(void)
+{
+	struct switch_rule *rule;
+	struct switch_point *sp;
+	double value = 0;
+
+	list_for_each_entry(rule, &__switch_rules, list) {
+		value = __evaluate_metric(rule->metric);
+
+		if ((strmatch(rule->op, "<") && value < rule->value) ||
+				(strmatch(rule->op, "<=") && value <= rule->value) ||
+				(strmatch(rule->op, ">") && value > rule->value) ||
+				(strmatch(rule->op, ">=") && value >= rule->value)) {
+			break;
+		}
+	}
+
+	/* Start a new window */
+	__monitor.runqueue = __monitor.busy = __monitor.blocked = 0;
+	__monitor.nr_responses = 0;
+	__monitor.response = 0;
+
+	if (&rule->list == &__switch_rules || rule->sched == sched) return;
+
+	if (sched->finalize) sched->finalize();
+	sched = rule->sched;
+	if (sched->initialize && sched->initialize()) {
+		fprintf(stderr, "Failed to initialize %s scheduler\n", sched->name);
+		exit(EXIT_FAILURE);
+	}
+
+	sp = malloc(sizeof(*sp));
+	sp->at = ticks;
+	sp->sched = sched;
+	sp->rule = rule;
+	sp->value = value;
+	list_add_tail(&sp->list, &__switch_points);
+
+	__print_event(EVENT_SWITCH, -1, "switch to %s", sched->name);
+}
+
+static void __calc_load(void);
+static void __export_metrics(void);
+
+
+/***********************************************************************
+ * The main loop for the scheduler simulation
+ */
+static void __do_simulation(void)
+{
+	assert(sched->schedule && "scheduler.schedule() not implemented");
+
+	while (true) {
+		bool scheduled[MAX_NR_CPUS] = { false };
+		bool running = false;
+		struct cpu *cpu;
+
+		/* Fire timers expiring at this tick */
+		run_timers(ticks);
+
+		/* Switch the scheduler at the end of the monitoring window */
+		if (__monitor.window && ticks && ticks % __monitor.window == 0) {
+			__switch_scheduler();
+		}
+
+		/* Fork processes on schedule */
+		__fork_on_schedule();
+
+		/**
+		 * Ask scheduler to pick the next process to run on each CPU. The CPUs
+		 * that ran processes in the previous tick go first, and then the idle
+		 * ones in the order of placement preference.
+		 */
+		for (int i = 0; i < nr_cpus; i++) {
+			cpu = __cpus_by_capacity[i];
+			if (!cpu->current) continue;
+
+			__schedule_cpu(cpu);
+			scheduled[cpu->id] = true;
+		}
+
+		memset(__nr_busy_threads, 0x00, sizeof(__nr_busy_threads));
+		for (int i = 0; i < nr_cpus; i++) {
+			if (cpus[i].current) __nr_busy_threads[cpus[i].core]++;
+		}
+
+		while ((cpu = __pick_idle_cpu(scheduled))) {
+			__schedule_cpu(cpu);
+			scheduled[cpu->id] = true;
+			if (cpu->current) __nr_busy_threads[cpu->core]++;
+		}
+
+		/* Move processes to idle CPUs where they run faster */
+		__balance_cpus();
+
+		for (int i = 0; i < nr_cpus; i++) {
+			if (cpus[i].current) running = true;
+		}
+
+		/* Processes ready to run but not running */
+		for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+			__monitor.runqueue += __sched_classes[i].nr_running;
+		}
+		for (int i = 0; i < nr_cpus; i++) {
+			if (cpus[i].current) __monitor.runqueue--;
+		}
+
+		if (__export.file) {
+			if (ticks % LOAD_FREQ == 0) __calc_load();
+			if (ticks && ticks % __export.every == 0) __export_metrics();
+		}
+
+		/* Quit simulation if no process is running nor pending */
+		if (!running && list_empty(&readyqueue) && list_empty(&__forkqueue) &&
+				!__swf.next &&
+				list_empty(&__admission.queue) &&
+				!__nr_throttled && !__nr_sleeping &&
+				!__sched_classes[SCHED_CLASS_RT].nr_running &&
+				!__sched_classes[SCHED_CLASS_IDLE].nr_running) {
+			/* Export the last window unless just done */
+			if (__export.file && ticks % __export.every) __export_metrics();
+			break;
+		}
+
+		for (int i = 0; i < nr_cpus; i++) {
+			cpu = cpus + i;
+			current = cpu->current;
+
+			/* No process is ready to run on this CPU at this moment */
+			if (!current) {
+				trace_sched(idle, -1, -1, -1);
+
+				/* Idle temporarily */
+				if (nr_cpus <= 1) {
+					__print_event(EVENT_IDLE, -1, "idle");
+				} else {
+					__print_event(EVENT_IDLE, -1, "idle@%d", cpu->id);
+				}
+				continue;
+			}
+
+			__run_current(cpu);
+		}
+
+		/* Increase the tick counter */
+		ticks++;
+	}
+}
+
+
+/**
+ * Decay the load averages toward the number of active processes
+ */
+static unsigned long __decay_load(unsigned long load, unsigned long exp, unsigned long active)
+{
+	unsigned long newload = load * exp + active * (FIXED_1 - exp);
+
+	if (active >= load) newload += FIXED_1 - 1;
+	return newload / FIXED_1;
+}
+
+static void __calc_load(void)
+{
+	unsigned long active = __nr_blocked + __nr_io_waiting;
+
+	for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+		active += __sched_classes[i].nr_running;
+	}
+	active *= FIXED_1;
+
+	__export.avenrun[0] = __decay_load(__export.avenrun[0], EXP_1, active);
+	__export.avenrun[1] = __decay_load(__export.avenrun[1], EXP_5, active);
+	__export.avenrun[2] = __decay_load(__export.avenrun[2], EXP_15, active);
+}
+
+#define LOAD_INT(x)	((x) >> FSHIFT)
+#define LOAD_FRAC(x)	(((x) & (FIXED_1 - 1)) * 100 / FIXED_1)
+
+static const char *__export_metrics_sz[][2] = {
+	{ "runqueue", "Processes ready to run but not running" },
+	{ "load1", "Load average over 1 minute, taking a tick as a second" },
+	{ "load5", "Load average over 5 minutes" },
+	{ "load15", "Load average over 15 minutes" },
+	{ "utilization", "Fraction of the CPU ticks busy in the window" },
+	{ "blocked", "Processes blocked on resources" },
+	{ "forks", "Processes forked in the window" },
+	{ "exits", "Processes exited in the window" },
+	{ "resource_waiters", "Processes blocked on the resource" },
+};
+
+#define NR_EXPORT_METRICS	(sizeof(__export_metrics_sz) / sizeof(*__export_metrics_sz))
+
+/**
+ * Open the file to export the metrics, and write out the header. The .prom
+ * file is written out with the initial state instead.
+ */
+static bool __open_export(void)
+{
+	const char *ext = strrchr(__export.file, '.');
+
+	__export.prometheus = ext && strcmp(ext, ".prom") == 0;
+
+	if (__export.prometheus) {
+		__export.tmpfile = malloc(strlen(__export.file) + sizeof(".tmp"));
+		sprintf(__export.tmpfile, "%s.tmp", __export.file);
+
+		__export_metrics();
+		return __export.file != NULL;
+	}
+
+	if (!(__export.fp = fopen(__export.file, "w"))) {
+		fprintf(stderr, "Cannot open %s to export metrics\n", __export.file);
+		return false;
+	}
+
+	fprintf(__export.fp, "tick");
+	for (int i = 0; i < NR_EXPORT_METRICS - 1; i++) {
+		fprintf(__export.fp, ",%s", __export_metrics_sz[i][0]);
+	}
+	for (int i = 0; i < NR_RESOURCES; i++) {
+		if (resources[i].__used) fprintf(__export.fp, ",resource%d", i);
+	}
+	fprintf(__export.fp, "\n");
+	return true;
+}
+
+/**
+ * Write out the metrics of the window ending now. The .prom file groups each
+ * metric with its HELP and TYPE, and carries no timestamp as the textfile
+ * collector rejects them; the tick is exported as sched_tick instead.
+ */
+static void __export_metrics(void)
+{
+	FILE *fp = __export.fp;
+	unsigned int nr_running = 0, runqueue, busy_ticks = 0;
+	unsigned int window = ticks - __export.sampled_at;
+	char values[NR_EXPORT_METRICS - 1][16];
+
+	for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+		nr_running += __sched_classes[i].nr_running;
+	}
+	runqueue = nr_running;
+	for (int i = 0; i < nr_cpus; i++) {
+		if (cpus[i].current) runqueue--;
+		busy_ticks += cpus[i].__busy_ticks;
+	}
+
+	/* In the order of @__export_metrics_sz */
+	sprintf(values[0], "%d", runqueue);
+	for (int i = 0; i < 3; i++) {
+		sprintf(values[1 + i], "%lu.%02lu",
+				LOAD_INT(__export.avenrun[i]), LOAD_FRAC(__export.avenrun[i]));
+	}
+	sprintf(values[4], "%.3f", window ?
+			(double)(busy_ticks - __export.busy_ticks) / (window * nr_cpus) : 0.0);
+	sprintf(values[5], "%d", __nr_blocked);
+	sprintf(values[6], "%d", __export.nr_forks);
+	sprintf(values[7], "%d", __export.nr_exits);
+
+	if (__export.prometheus) {
+		if (!(fp = fopen(__export.tmpfile, "w"))) {
+			fprintf(stderr, "Cannot open %s to export metrics\n", __export.tmpfile);
+			__export.file = NULL;
+			return;
+		}
+
+		fprintf(fp, "# HELP sched_tick Tick of the sample\n");
+		fprintf(fp, "# TYPE sched_tick gauge\n");
+		fprintf(fp, "sched_tick %d\n", ticks);
+		for (int i = 0; i < NR_EXPORT_METRICS; i++) {
+			fprintf(fp, "# HELP sched_%s %s\n",
+					__export_metrics_sz[i][0], __export_metrics_sz[i][1]);
+			fprintf(fp, "# TYPE sched_%s gauge\n", __export_metrics_sz[i][0]);
+			if (i < NR_EXPORT_METRICS - 1) {
+				fprintf(fp, "sched_%s %s\n", __export_metrics_sz[i][0], values[i]);
+			}
+		}
+		for (int i = 0; i < NR_RESOURCES; i++) {
+			if (!resources[i].__used) continue;
+			fprintf(fp, "sched_resource_waiters{resource=\"%d\"} %d\n",
+					i, resources[i].__nr_waiters);
+		}
+
+		fclose(fp);
+		rename(__export.tmpfile, __export.file);
+	} else {
+		fprintf(fp, "%d", ticks);
+		for (int i = 0; i < NR_EXPORT_METRICS - 1; i++) {
+			fprintf(fp, ",%s", values[i]);
+		}
+		for (int i = 0; i < NR_RESOURCES; i++) {
+			if (resources[i].__used) fprintf(fp, ",%d", resources[i].__nr_waiters);
+		}
+		fprintf(fp, "\n");
+	}
+
+	__export.sampled_at = ticks;
+	__export.busy_ticks = busy_ticks;
+	__export.nr_forks = __export.nr_exits = 0;
+}
+
+/**
+ * Summarize the CPU usage and latency of the groups. The CPU usage of a group
+ * includes the usage of its descendant groups.
+ */
+static void __report_groups(void)
+{
+	unsigned int busy_ticks[MAX_NR_GROUPS];
+
+	/* Parents are always declared before their children */
+	for (int i = 0; i < nr_groups; i++) {
+		busy_ticks[i] = groups[i].__busy_ticks;
+	}
+	for (int i = nr_groups - 1; i > 0; i--) {
+		busy_ticks[groups[i].parent->id] += busy_ticks[i];
+	}
+
+	for (int i = 0; i < nr_groups; i++) {
+		struct group *g = groups + i;
+
+		printf("Group %-8s: %d process%s, busy %d tick%s (%3d%%)",
+				g->name, g->__nr_processes, g->__nr_processes != 1 ? "es" : "",
+				busy_ticks[i], busy_ticks[i] != 1 ? "s" : "",
+				ticks ? busy_ticks[i] * 100 / (ticks * nr_cpus) : 0);
+		if (g->__nr_exited) {
+			printf(", response %.2f, turnaround %.2f",
+					g->__nr_responses ? (double)g->__response / g->__nr_responses : 0.0,
+					(double)g->__turnaround / g->__nr_exited);
+		}
+		printf("\n");
+	}
+}
+
+/**
+ * Summarize the throttling and its impact on the latency
+ */
+static void __report_bandwidths(void)
+{
+	struct bandwidth *bw;
+
+	list_for_each_entry(bw, &__bandwidths, list) {
+		printf("Bandwidth of %s: %d/%d, throttled %d time%s for %d tick%s\n",
+				bw->name, bw->quota, bw->period,
+				bw->nr_throttled, bw->nr_throttled != 1 ? "s" : "",
+				bw->throttled_ticks, bw->throttled_ticks != 1 ? "s" : "");
+	}
+
+	if (__nr_throttled_exited) {
+		double turnaround = (double)__throttled_turnaround / __nr_throttled_exited;
+		double throttled = (double)__throttled_ticks / __nr_throttled_exited;
+
+		printf("Throttled processes: %d, turnaround %.2f, %.2f of which throttled (x%.2f)\n",
+				__nr_throttled_exited, turnaround, throttled,
+				turnaround / (turnaround - throttled));
+	}
+}
+
+/**
+ * Summarize the simulation into @o
+ */
+static void __collect_outcome(struct outcome *o)
+{
+	memset(o, 0x00, sizeof(*o));
+
+	o->makespan = ticks;
+	for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+		o->nr_exited += __sched_classes[i].nr_exited;
+		o->response += __sched_classes[i].response;
+		o->turnaround += __sched_classes[i].turnaround;
+	}
+}
+
+static void __report_predictor(void)
+{
+	struct outcome o;
+	double response, turnaround;
+
+	__collect_outcome(&o);
+	if (!o.nr_exited || !__clairvoyant.nr_exited) return;
+
+	if (__predictor == PREDICTOR_AVERAGE) {
+		printf("Predicted by exponential average");
+	} else {
+		printf("Predicted by %d%% quantile", __quantile);
+	}
+	printf(", off by %.2f ticks on average\n",
+			(double)__prediction_error / __nr_predictions);
+
+	response = (double)o.response / o.nr_exited;
+	turnaround = (double)o.turnaround / o.nr_exited;
+	printf("Regret: response %.2f (%+.2f), turnaround %.2f (%+.2f), "
+			"makespan %d (%+d) against the clairvoyance\n",
+			response, response - (double)__clairvoyant.response / __clairvoyant.nr_exited,
+			turnaround, turnaround - (double)__clairvoyant.turnaround / __clairvoyant.nr_exited,
+			o.makespan, (int)o.makespan - (int)__clairvoyant.makespan);
+}
+
+/**
+ * Summarize the simulation
+ */
+static void __report(void)
+{
+	unsigned int busy_ticks = 0, spin_ticks = 0;
+
+	if (quiet) return;
+
+	printf("\n");
+	printf("***** REPORT **********\n");
+	printf("Makespan: %d tick%s\n", ticks, ticks != 1 ? "s" : "");
+	for (int i = 0; i < nr_cpus; i++) {
+		struct cpu *c = cpus + i;
+		printf("CPU %2d: capacity %3d%%, busy %d tick%s (%3d%%), %d migration%s",
+				c->id, c->capacity,
+				c->__busy_ticks, c->__busy_ticks != 1 ? "s" : "",
+				ticks ? c->__busy_ticks * 100 / ticks : 0,
+				c->__migrations, c->__migrations != 1 ? "s" : "");
+		if (__smt) {
+			printf(", %d tick%s with busy siblings",
+					c->__smt_ticks, c->__smt_ticks != 1 ? "s" : "");
+		}
+		if (c->__spin_ticks) {
+			printf(", %d tick%s spinning",
+					c->__spin_ticks, c->__spin_ticks != 1 ? "s" : "");
+		}
+		printf("\n");
+
+		busy_ticks += c->__busy_ticks;
+		spin_ticks += c->__spin_ticks;
+	}
+
+	for (int i = 0; i < NR_RESOURCES; i++) {
+		struct resource *r = resources + i;
+		if (!r->__spin_ticks && !r->__nr_sleeps) continue;
+
+		printf("Resource %2d: %s lock, %d tick%s spinning, %d sleep%s\n",
+				i, __resource_type_sz[r->type],
+				r->__spin_ticks, r->__spin_ticks != 1 ? "s" : "",
+				r->__nr_sleeps, r->__nr_sleeps != 1 ? "s" : "");
+	}
+	if (spin_ticks) {
+		printf("Throughput lost to spinning: %d of %d busy ticks (%d%%)\n",
+				spin_ticks, busy_ticks, spin_ticks * 100 / busy_ticks);
+	}
+
+	if (nr_groups > 1) __report_groups();
+
+	if (!list_empty(&__bandwidths)) __report_bandwidths();
+
+	for (int i = 0; i < __nr_devices; i++) {
+		struct device *dev = __devices + i;
+		if (!dev->__nr_requests) continue;
+
+		printf("Device %2d %s: %d request%s, busy %d tick%s (%3d%%), utilization %3d%%, wait %.2f\n",
+				dev->id, dev->name,
+				dev->__nr_requests, dev->__nr_requests != 1 ? "s" : "",
+				dev->__busy_ticks, dev->__busy_ticks != 1 ? "s" : "",
+				ticks ? dev->__busy_ticks * 100 / ticks : 0,
+				ticks ? (int)(dev->__service_ticks * 100 / (ticks * dev->parallelism)) : 0,
+				(double)dev->__wait_ticks / dev->__nr_requests);
+	}
+
+	for (int i = 0; i < MAX_NR_BARRIERS; i++) {
+		struct barrier *b = __barriers + i;
+		if (!b->count) continue;
+
+		printf("Barrier %2d: %d round%s of %d, %d wait%s, stalled %llu tick%s (%.2f on average, %d at most)\n",
+				i, b->nr_rounds, b->nr_rounds != 1 ? "s" : "", b->count,
+				b->nr_waits, b->nr_waits != 1 ? "s" : "",
+				b->stall_ticks, b->stall_ticks != 1 ? "s" : "",
+				b->nr_waits ? (double)b->stall_ticks / b->nr_waits : 0.0,
+				b->max_stall);
+
+		/* The round never completed leaves its arrivals waiting forever */
+		if (b->nr_arrived) {
+			struct barrier_schedule *bs;
+
+			printf("Barrier %2d: %d more process%s never arrived, stranding process%s",
+					i, b->count - b->nr_arrived, b->count - b->nr_arrived != 1 ? "es" : "",
+					b->nr_arrived != 1 ? "es" : "");
+			list_for_each_entry(bs, &b->waiters, list) {
+				printf(" %d", bs->process->pid);
 			}
+			printf("\n");
 		}
 	}
-	printf("\n\n");
 
-	return;
-}
+	if (__watchdog.ready || __watchdog.blocked) {
+		printf("Watchdog: %d alert%s on the CPU wait (waited %d ticks at most), "
+				"%d alert%s on the resource wait (waited %d ticks at most)\n",
+				__watchdog.nr_ready_alerts, __watchdog.nr_ready_alerts != 1 ? "s" : "",
+				__watchdog.longest_ready,
+				__watchdog.nr_blocked_alerts, __watchdog.nr_blocked_alerts != 1 ? "s" : "",
+				__watchdog.longest_blocked);
+	}
 
-#define __print_event(pid, string, args...) do { \
-	fprintf(stderr, "%3d: ", ticks); \
-	for (int i = 0; i < pid; i++) { \
-		fprintf(stderr, "    "); \
-	} \
-	fprintf(stderr, string "\n", ##args); \
-} while (0);
+	if (__admission.limit != ADMIT_ALL) {
+		struct admission *a = &__admission;
 
-static inline bool strmatch(char * const str, const char *expect)
-{
-	return (strlen(str) == strlen(expect)) && (strncmp(str, expect, strlen(expect)) == 0);
-}
+		printf("Admission: %d of %d admitted (%d%%), %d rejected, %d shed, "
+				"wait %.2f on average (%d at most), turnaround %.2f since arrival\n",
+				a->nr_admitted, a->nr_arrived,
+				a->nr_arrived ? a->nr_admitted * 100 / a->nr_arrived : 0,
+				a->nr_rejected, a->nr_shed,
+				a->nr_admitted ? (double)a->wait_ticks / a->nr_admitted : 0.0,
+				a->max_wait,
+				a->nr_admitted ? (double)a->turnaround / a->nr_admitted : 0.0);
+	}
 
-static void __briefing_process(struct process *p)
-{
-	struct resource_schedule *rs;
+	for (int i = 0; i < MAX_NR_CHANNELS; i++) {
+		struct channel *c = __channels + i;
+		if (!c->nr_passed && list_empty(&c->senders) && list_empty(&c->receivers)) continue;
 
-	if (quiet) return;
+		__update_channel(c, 0);
+		printf("Channel %2d: capacity %d, %d message%s (%.2f per tick), occupancy %.2f, "
+				"senders blocked %llu tick%s, receivers blocked %llu tick%s\n",
+				i, c->capacity, c->nr_passed, c->nr_passed != 1 ? "s" : "",
+				ticks ? (double)c->nr_passed / ticks : 0.0,
+				ticks ? (double)c->occupancy / ticks : 0.0,
+				c->send_ticks, c->send_ticks != 1 ? "s" : "",
+				c->recv_ticks, c->recv_ticks != 1 ? "s" : "");
+	}
 
-	printf("- Process %d: Forked at tick %d and run for %d tick%s with initial priority %d\n",
-				p->pid, p->__starts_at, p->lifespan,
-				p->lifespan >= 2 ? "s" : "", p->prio);
+	if (__swf.file) {
+		struct sched_class *class = __sched_classes + SCHED_CLASS_FAIR;
 
-	list_for_each_entry(rs, &p->__resources_to_acquire, list) {
-		printf("    Acquire resource %d at %d for %d\n", rs->resource_id, rs->at, rs->duration);
+		printf("Jobs: %llu streamed, %llu skipped without the runtime",
+				__swf.nr_jobs, __swf.nr_skipped);
+		if (class->nr_exited) {
+			printf(", response %.2f, turnaround %.2f",
+					(double)class->response / class->nr_exited,
+					(double)class->turnaround / class->nr_exited);
+		}
+		printf("\n");
 	}
-}
 
-static int __load_script(char * const filename)
-{
-	char line[256];
-	struct process *p = NULL;
+	if (__predictor != PREDICTOR_NONE) __report_predictor();
 
-	FILE *file = fopen(filename, "r");
-	while (fgets(line, sizeof(line), file)) {
-		char *tokens[32] = { NULL };
-		int nr_tokens;
+	/* The makespan is not comparable if some processes were turned away */
+	if (__critical_path && !__admission.nr_rejected && !__admission.nr_shed) {
+		printf("Critical path: %d tick%s, makespan x%.2f of it\n",
+				__critical_path, __critical_path != 1 ? "s" : "",
+				(double)ticks / __critical_path);
+	}
 
-		parse_command(line, &nr_tokens, tokens);
+	if (!list_empty(&__switch_points)) {
+		struct switch_point *sp;
 
-		if (nr_tokens == 0) continue;
+		list_for_each_entry(sp, &__switch_points, list) {
+			printf("Switched to %s at tick %d (%s %.2f %s %g)\n",
+					sp->sched->name, sp->at, __metric_sz[sp->rule->metric],
+					sp->value, sp->rule->op, sp->rule->value);
+		}
+	}
 
-		if (strmatch(tokens[0], "process")) {
-			assert(nr_tokens == 2);
-			/* Start processor description */
-			p = malloc(sizeof(*p));
-			memset(p, 0x00, sizeof(*p));
+	if (__sched_classes[SCHED_CLASS_RT].nr_processes ||
+			__sched_classes[SCHED_CLASS_IDLE].nr_processes) {
+		for (int i = 0; i < NR_SCHED_CLASSES; i++) {
+			struct sched_class *class = __sched_classes + i;
 
-			p->pid = atoi(tokens[1]);
+			printf("Class %-4s: %d process%s", class->name,
+					class->nr_processes, class->nr_processes != 1 ? "es" : "");
+			if (class->nr_exited) {
+				printf(", response %.2f, turnaround %.2f",
+						(double)class->response / class->nr_exited,
+						(double)class->turnaround / class->nr_exited);
+			}
+			printf("\n");
+		}
+	}
+}
 
-			INIT_LIST_HEAD(&p->list);
-			INIT_LIST_HEAD(&p->__resources_to_acquire);
-			INIT_LIST_HEAD(&p->__resources_holding);
 
-			continue;
-		} else if (strmatch(tokens[0], "end")) {
-			/* End of process description */
-			struct resource_schedule *rs;
-			assert(p);
+/**
+ * Set up CPUs declared in the process description file
+ */
+static void __initialize_cpus(void)
+{
+	/* Run on a single nominal CPU unless CPUs are declared */
+	if (nr_cpus == 0) {
+		cpus[0].capacity = CAPACITY_SCALE;
+		cpus[0].core = 0;
+		nr_cpus = 1;
+	}
 
-			list_add_tail(&p->list, &__forkqueue);
+	for (int i = 0; i < nr_cpus; i++) {
+		int j;
 
-			__briefing_process(p);
-			p = NULL;
+		cpus[i].id = i;
+		cpus[i].current = NULL;
 
-			continue;
+		for (j = 0; j < i; j++) {
+			if (cpus[j].core == cpus[i].core) __smt = true;
 		}
 
-		if (strmatch(tokens[0], "lifespan")) {
-			assert(nr_tokens == 2);
-			p->lifespan = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "prio")) {
-			assert(nr_tokens == 2);
-			p->prio = p->prio_orig = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "start")) {
-			assert(nr_tokens == 2);
-			p->__starts_at = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "acquire")) {
-			struct resource_schedule *rs;
-			assert(nr_tokens == 4);
-
-			rs = malloc(sizeof(*rs));
+		/* Insertion sort is just fine for handful of CPUs */
+		for (j = i; j > 0 && __cpus_by_capacity[j - 1]->capacity < cpus[i].capacity; j--) {
+			__cpus_by_capacity[j] = __cpus_by_capacity[j - 1];
+		}
+		__cpus_by_capacity[j] = cpus + i;
+	}
 
-			rs->resource_id = atoi(tokens[1]);
-			rs->at = atoi(tokens[2]);
-			rs->duration = atoi(tokens[3]);
+	if (quiet || nr_cpus <= 1) return;
 
-			list_add_tail(&rs->list, &p->__resources_to_acquire);
-		} else {
-			fprintf(stderr, "Unknown property %s\n", tokens[0]);
-			return false;
-		}
+	for (int i = 0; i < nr_cpus; i++) {
+		printf("- CPU %d: Capacity %d%%", i, cpus[i].capacity);
+		if (__smt) printf(" on core %d", cpus[i].core);
+		printf("\n");
 	}
-	fclose(file);
-	if (!quiet) printf("\n");
-	return true;
+	if (__smt) {
+		printf("  SMT siblings run at %d%% while sharing a core\n", smt_rate);
+	}
+	printf("\n");
 }
 
 
-/**
- * Fork process on schedule
- */
-static int __fork_on_schedule()
+static void __initialize(void)
 {
-	int nr_forked = 0;
-	struct process *p, *tmp;
-	list_for_each_entry_safe(p, tmp, &__forkqueue, list) {
-		if (p->__starts_at <= ticks) {
-			list_move_tail(&p->list, &readyqueue);
-			p->status = PROCESS_READY;
-			__print_event(p->pid, "N");
-			if (sched->forked) sched->forked(p);
-			nr_forked++;
-		}
+	INIT_LIST_HEAD(&readyqueue);
+
+	for (int i = 0; i < NR_RESOURCES; i++) {
+		resources[i].owner = NULL;
+		INIT_LIST_HEAD(&(resources[i].waitqueue));
 	}
-	return nr_forked;
+
+	INIT_LIST_HEAD(&__forkqueue);
+
+	for (int i = 0; i < MAX_RT_PRIO; i++) {
+		INIT_LIST_HEAD(__rt_queues + i);
+	}
+	INIT_LIST_HEAD(&__idlequeue);
+
+	for (int i = 0; i < MAX_NR_BARRIERS; i++) {
+		INIT_LIST_HEAD(&__barriers[i].waiters);
+	}
+
+	for (int i = 0; i < MAX_NR_CHANNELS; i++) {
+		__channels[i].capacity = DEFAULT_CHANNEL_CAPACITY;
+		INIT_LIST_HEAD(&__channels[i].senders);
+		INIT_LIST_HEAD(&__channels[i].receivers);
+	}
+
+	strcpy(__devices[0].name, "disk");
+	__devices[0].parallelism = 1;
+	__devices[0].discipline = IO_FIFO;
+	INIT_LIST_HEAD(&__devices[0].queue);
+
+	strcpy(groups[0].name, "root");
+	groups[0].shares = DEFAULT_SHARES;
+	groups[0].se.weight = DEFAULT_SHARES;
+	groups[0].se.my_q = groups;
+	INIT_HEAP_NODE(&groups[0].se.run_node);
+
+	if (quiet) return;
+	printf("**************************************************************\n");
+	printf("*\n");
+	printf("*   Simulating %s scheduler\n", sched->name);
+	printf("*\n");
+	printf("**************************************************************\n");
+	printf("   N: Forked\n");
+	printf("   X: Finished\n");
+	printf("   =: Blocked\n");
+	printf("  +n: Acquire resource n\n");
+	printf("  -n: Release resource n\n");
+	printf("  ~n: Spin on resource n\n");
+	printf("   T: Throttled\n");
+	printf("  !n: Issue I/O to device n\n");
+	printf("   Z: Sleep\n");
+	printf("  ^n: Set priority to n\n");
+	printf("  |n: Arrive at barrier n\n");
+	printf("  >n: Send to channel n\n");
+	printf("  <n: Receive from channel n\n");
+	printf("   D: Held back from admission\n");
+	printf("   R: Rejected\n");
+	printf("   S: Shed\n");
+	printf("\n");
 }
 
+
 /**
- * Exit the process
+ * Simulate the processes in a child process after @prepare(@arg), and get
+ * the outcome in @o
  */
-static void __exit_process(struct process *p)
+static int __simulate_forked(struct outcome *o, void (*prepare)(unsigned int), unsigned int arg)
 {
-	/* Make sure the process is not attached to some list head */
-	assert(list_empty(&p->list));
+	int fds[2];
+	pid_t pid;
+	int status;
+	ssize_t len;
 
-	/* Make sure the process is not holding any resource */
-	assert(list_empty(&p->__resources_holding));
+	if (pipe(fds)) return -1;
 
-	/* Make sure there is no pending resource to acquire */
-	assert(list_empty(&p->__resources_to_acquire));
+	fflush(stdout);
+	fflush(stderr);
 
-	if (sched->exiting) sched->exiting(p);
+	if ((pid = fork()) < 0) return -1;
 
-	__print_event(p->pid, "X");
+	if (pid == 0) {
+		close(fds[0]);
+		quiet = true;
+		freopen("/dev/null", "w", stdout);
+		freopen("/dev/null", "w", stderr);
+		if (__swf.file) __reopen_swf();
 
-	free(p);
+		prepare(arg);
+		if (sched->initialize && sched->initialize()) _exit(EXIT_FAILURE);
+		__do_simulation();
+		if (sched->finalize) sched->finalize();
+
+		__collect_outcome(o);
+		len = write(fds[1], o, sizeof(*o));
+		_exit(len == sizeof(*o) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	len = read(fds[0], o, sizeof(*o));
+	close(fds[0]);
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+			WEXITSTATUS(status) != EXIT_SUCCESS || len != sizeof(*o)) {
+		return -1;
+	}
+	return 0;
 }
 
+static void __prepare_clairvoyant(unsigned int unused)
+{
+	__predictor = PREDICTOR_NONE;
+}
 
 /**
- * Process resource acqutision
+ * Simulate the same processes with the clairvoyance in a child process to
+ * measure the regret of the predictor
  */
-static bool __run_current_acquire()
+static int __simulate_clairvoyant(void)
 {
-	struct resource_schedule *rs, *tmp;
+	return __simulate_forked(&__clairvoyant, __prepare_clairvoyant, 0);
+}
 
-	list_for_each_entry_safe(rs, tmp, &current->__resources_to_acquire, list) {
-		if (rs->at == current->age) {
-			assert(sched->acquire && "scheduler.acquire() not implemented");
 
-			/* Callback to acquire the resource */
-			if (sched->acquire(rs->resource_id)) {
-				list_move_tail(&rs->list, &current->__resources_holding);
+/***********************************************************************
+ * Batch simulation of the sweeps
+ *
+ * The variants of a simple scenario are simulated in lock-step by
+ * batch_simulate(), and the others one by one in child processes.
+ */
+static unsigned int __sweep_value(struct process *p, enum sweep_property property,
+		unsigned int lane)
+{
+	struct sweep *sw;
 
-				__print_event(current->pid, "+%d", rs->resource_id);
-			} else {
-				return false;
-			}
-		}
+	list_for_each_entry(sw, &__sweeps, list) {
+		if (sw->process == p && sw->property == property) return sw->values[lane];
 	}
 
-	return true;
+	switch (property) {
+	case SWEEP_START:
+		return p->__starts_at;
+	case SWEEP_LIFESPAN:
+		return p->__lifespan;
+	default:
+		return p->prio_orig;
+	}
 }
 
 /**
- * Process resource release
+ * Set up the processes for @lane
  */
-static void __run_current_release()
+static void __prepare_lane(unsigned int lane)
 {
-	struct resource_schedule *rs, *tmp;
-
-	list_for_each_entry_safe(rs, tmp, &current->__resources_holding, list) {
-		if (--rs->duration == 0) {
-			assert(sched->release && "scheduler.release() not implemented");
-
-			/* Callback the release() */
-			sched->release(rs->resource_id);
+	struct sweep *sw;
 
-			__print_event(current->pid, "-%d", rs->resource_id);
+	list_for_each_entry(sw, &__sweeps, list) {
+		struct process *p = sw->process;
+		unsigned int value = sw->values[lane];
 
-			list_del(&rs->list);
-			free(rs);
+		switch (sw->property) {
+		case SWEEP_START:
+			p->__starts_at = value;
+			break;
+		case SWEEP_LIFESPAN:
+			p->lifespan = p->__lifespan = p->burst = value;
+			break;
+		default:
+			p->prio = p->prio_orig = value;
+			break;
 		}
 	}
 }
 
-
-/***********************************************************************
- * The main loop for the scheduler simulation
+/**
+ * Check whether all lanes can be simulated in lock-step with @policy. Up to
+ * BATCH_MAX_PROCESSES processes should only run on a single nominal CPU
  */
-static void __do_simulation(void)
+static bool __batchable(enum batch_policy *policy)
 {
-	assert(sched->schedule && "scheduler.schedule() not implemented");
+	struct process *p;
+	unsigned int nr_processes = 0;
 
-	while (true) {
-		struct process *prev;
+	if (sched == &fifo_scheduler) {
+		*policy = BATCH_FIFO;
+	} else if (sched == &sjf_scheduler) {
+		*policy = BATCH_SJF;
+	} else if (sched == &srtf_scheduler) {
+		*policy = BATCH_SRTF;
+	} else if (sched == &rr_scheduler) {
+		*policy = BATCH_RR;
+	} else if (sched == &prio_scheduler || sched == &pip_scheduler) {
+		*policy = BATCH_PRIO;
+	} else {
+		return false;
+	}
 
-		/* Fork processes on schedule */
-		__fork_on_schedule();
+	if (nr_cpus != 1 || cpus[0].capacity != CAPACITY_SCALE) return false;
+	if (__predictor != PREDICTOR_NONE || __monitor.window) return false;
+	if (__admission.limit != ADMIT_ALL || !list_empty(&__dependents)) return false;
+
+	list_for_each_entry(p, &__forkqueue, list) {
+		if (p->sched_class != SCHED_CLASS_FAIR || p->__nr_threads != 1 ||
+				p->__bandwidth || p->__behavior ||
+				!list_empty(&p->__resources_to_acquire) ||
+				!list_empty(&p->__io_to_issue) ||
+				!list_empty(&p->__prio_to_set) ||
+				!list_empty(&p->__barriers_to_reach) ||
+				!list_empty(&p->__messages_to_pass) ||
+				!list_empty(&p->__successors)) {
+			return false;
+		}
+		for (struct group *g = p->group; g; g = g->parent) {
+			if (g->__bandwidth) return false;
+		}
+		for (int l = 0; l < __nr_lanes; l++) {
+			if (!__sweep_value(p, SWEEP_LIFESPAN, l)) return false;
+		}
+		if (++nr_processes > BATCH_MAX_PROCESSES) return false;
+	}
+	return true;
+}
 
-		/* Ask scheduler to pick the next process to run */
-		prev = current;
-		current = sched->schedule();
+/**
+ * Simulate the lanes in lock-step into @o
+ */
+static int __simulate_lockstep(enum batch_policy policy, struct outcome o[])
+{
+	struct batch b = {
+		.policy = policy,
+		.aging_step = aging_step,
+		.aging_period = aging_period,
+		.nr_lanes = __nr_lanes,
+	};
+	struct process *p;
+	unsigned int i = 0;
+	int ret;
 
-		/* If the system ran a process in the previous tick, */
-		if (prev) {
-			/* Update the process status */
-			if (prev->status == PROCESS_RUNNING) {
-				prev->status = PROCESS_READY;
-			}
+	list_for_each_entry(p, &__forkqueue, list) b.nr_processes++;
 
-			/* Decommission it if completed */
-			if (prev->age == prev->lifespan) {
-				prev->status = PROCESS_EXIT;
-				__exit_process(prev);
-			}
-		}
+	b.start = calloc(b.nr_processes, sizeof(lanes_t));
+	b.lifespan = calloc(b.nr_processes, sizeof(lanes_t));
+	b.prio = calloc(b.nr_processes, sizeof(lanes_t));
+	if (!b.start || !b.lifespan || !b.prio) {
+		ret = -1;
+		goto out;
+	}
 
-		/* No process is ready to run at this moment */
-		if (!current) {
-			/* Quit simulation if no pending process exists */
-			if (list_empty(&readyqueue) && list_empty(&__forkqueue)) {
-				break;
-			}
+	/* Lay out the processes in the lanes */
+	list_for_each_entry(p, &__forkqueue, list) {
+		for (int l = 0; l < BATCH_LANES; l++) {
+			unsigned int lane = l < __nr_lanes ? l : 0;
 
-			/* Idle temporarily */
-			fprintf(stderr, "%3d: idle\n", ticks);
-			goto next;
+			b.start[i][l] = __sweep_value(p, SWEEP_START, lane);
+			b.lifespan[i][l] = __sweep_value(p, SWEEP_LIFESPAN, lane);
+			b.prio[i][l] = __sweep_value(p, SWEEP_PRIO, lane);
 		}
+		i++;
+	}
 
-		/* Execute the current process */
-		current->status = PROCESS_RUNNING;
-
-		/* Ensure that @current is detached from any list */
-		assert(list_empty(&current->list));
+	if ((ret = batch_simulate(&b))) goto out;
 
-		/* Try acquiring scheduled resources */
-		if (__run_current_acquire()) {
-			/* Succesfully acquired all the resources to make a progress! */
-			__print_event(current->pid, "%d", current->pid);
+	for (int l = 0; l < __nr_lanes; l++) {
+		o[l].makespan = b.makespan[l];
+		o[l].nr_exited = b.nr_exited[l];
+		o[l].response = b.response[l];
+		o[l].turnaround = b.turnaround[l];
+	}
 
-			/* So, it ages by one tick */
-			current->age++;
+out:
+	free(b.start);
+	free(b.lifespan);
+	free(b.prio);
+	return ret;
+}
 
-			/* And performs scheduled releases */
-			__run_current_release();
-		} else {
-			/**
-			 * The current is blocked while acquiring resource(s).
-			 * In this case, @current could not make a progress in this tick
-			 */
-			__print_event(current->pid, "=");
+static int __simulate_batch(void)
+{
+	struct outcome o[BATCH_LANES];
+	enum batch_policy policy;
+	bool lockstep = __batchable(&policy);
+	struct sweep *sw;
 
-			/* Thus, it is not get aged nor unable to perform releases */
+	if (lockstep) {
+		if (__simulate_lockstep(policy, o)) return -1;
+	} else {
+		for (int l = 0; l < __nr_lanes; l++) {
+			if (__simulate_forked(o + l, __prepare_lane, l)) return -1;
 		}
+	}
 
-next:
-		/* Increase the tick counter */
-		ticks++;
+	if (!quiet) {
+		printf("\n");
+		printf("***** BATCH **********\n");
+		printf("Simulated %d variant%s %s\n", __nr_lanes, __nr_lanes != 1 ? "s" : "",
+				lockstep ? "in lock-step" : "one by one");
+	}
+	for (int l = 0; l < __nr_lanes; l++) {
+		printf("Lane %2d:", l);
+		list_for_each_entry(sw, &__sweeps, list) {
+			printf(" %d", sw->process->pid);
+			if (sw->process->__tid) printf(".%d", sw->process->__tid);
+			printf(".%s=%d", __sweep_property_sz[sw->property], sw->values[l]);
+		}
+		printf(", makespan %d", o[l].makespan);
+		if (o[l].nr_exited) {
+			printf(", response %.2f, turnaround %.2f",
+					(double)o[l].response / o[l].nr_exited,
+					(double)o[l].turnaround / o[l].nr_exited);
+		}
+		printf("\n");
 	}
+	return 0;
 }
 
 
-static void __initialize(void)
+/**
+ * Set up the trace filter given by -t as @filter=@value
+ */
+static bool __setup_trace(char *spec)
 {
-	INIT_LIST_HEAD(&readyqueue);
+	char *value = strchr(spec, '=');
+	char *tok;
 
-	for (int i = 0; i < NR_RESOURCES; i++) {
-		resources[i].owner = NULL;
-		INIT_LIST_HEAD(&(resources[i].waitqueue));
-	}
+	if (!value) return false;
+	*value++ = '\0';
+	__trace.filtering = true;
 
-	INIT_LIST_HEAD(&__forkqueue);
+	if (strmatch(spec, "pid")) {
+		for (tok = strtok(value, ","); tok; tok = strtok(NULL, ",")) {
+			if (__trace.nr_pids == MAX_TRACE_PIDS) return false;
+			__trace.pids[__trace.nr_pids++] = atoi(tok);
+		}
+	} else if (strmatch(spec, "kind")) {
+		/* Print the listed kinds, or all but the ones listed with '-' */
+		__trace.kinds = value[0] == '-' ? (1U << NR_EVENT_KINDS) - 1 : 0;
+		for (tok = strtok(value, ","); tok; tok = strtok(NULL, ",")) {
+			bool exclude = tok[0] == '-';
+			int i;
 
-	if (quiet) return;
-	printf("**************************************************************\n");
-	printf("*\n");
-	printf("*   Simulating %s scheduler\n", sched->name);
-	printf("*\n");
-	printf("**************************************************************\n");
-	printf("   N: Forked\n");
-	printf("   X: Finished\n");
-	printf("   =: Blocked\n");
-	printf("  +n: Acquire resource n\n");
-	printf("  -n: Release resource n\n");
-	printf("\n");
+			for (i = 0; i < NR_EVENT_KINDS; i++) {
+				if (strmatch(tok + exclude, __event_kind_sz[i])) break;
+			}
+			if (i == NR_EVENT_KINDS) return false;
+
+			if (exclude) {
+				__trace.kinds &= ~(1U << i);
+			} else {
+				__trace.kinds |= 1U << i;
+			}
+		}
+	} else if (strmatch(spec, "tick")) {
+		char *to = strchr(value, ':');
+
+		__trace.from = atoi(value);
+		if (to && to[1]) __trace.to = atoi(to + 1);
+	} else if (strmatch(spec, "every")) {
+		if ((__trace.every = atoi(value)) == 0) return false;
+	} else if (strmatch(spec, "reservoir")) {
+		if ((__trace.reservoir = atoi(value)) == 0) return false;
+		__trace.kept = calloc(__trace.reservoir, sizeof(*__trace.kept));
+	} else {
+		return false;
+	}
+	return true;
 }
 
 
 static void __print_usage(char * const name)
 {
-	printf("Usage: %s {-q} -[f|s|S|r|p|i] [process script file]\n", name);
+	printf("Usage: %s {-q} {-n ema|q<percent>} {-e file} {-w ticks} {-t filter=value} {-k usecs} {-j secs} -[f|s|S|r|p|i|g] [process script file]\n", name);
 	printf("\n");
-	printf("  -q: Run quietly\n\n");
+	printf("  -q: Run quietly\n");
+	printf("  -n: Hide the lifespan and predict it with the exponential average\n");
+	printf("      (ema) or a quantile (e.g., q50) of the previous runs\n");
+	printf("  -e: Export the metrics to the file every 10 ticks, in the Prometheus\n");
+	printf("      text format if the file name ends with .prom, or in CSV otherwise\n");
+	printf("  -w: Export the metrics every given ticks instead\n");
+	printf("  -t: Filter the events to print. Can be given multiple times\n");
+	printf("      pid=1,3        Events of processes 1 and 3\n");
+	printf("      kind=run,idle  Events of the kinds; fork, exit, run, idle, block,\n");
+	printf("                     acquire, release, spin, throttle, io, prio, sync,\n");
+	printf("                     admit, and switch. kind=-run prints all kinds but run\n");
+	printf("      tick=10:50     Events in ticks 10 to 49\n");
+	printf("      every=100      One in 100 events\n");
+	printf("      reservoir=100  100 events sampled uniformly\n");
+	printf("  -k: Import the file as a Linux scheduler trace from ftrace or perf sched\n");
+	printf("      script instead, taking the given microseconds as a tick\n");
+	printf("  -j: Stream the jobs from the file in the Standard Workload Format instead,\n");
+	printf("      taking the given seconds as a tick\n\n");
 	printf("  -f: Use FIFO scheduler (default)\n");
 	printf("  -s: Use SJF scheduler\n");
 	printf("  -S: Use SRTF scheduler\n");
 	printf("  -r: Use Round-robin scheduler\n");
 	printf("  -p: Use Priority scheduler\n");
-	printf("  -i: Use Priority with PIP scheduler\n\n");
+	printf("  -i: Use Priority with PIP scheduler\n");
+	printf("  -g: Use hierarchical fair scheduler\n\n");
 }
 
 
@@ -434,11 +5065,49 @@ int main(int argc, char * const argv[])
 	int opt;
 	char *scriptfile;
 
-	while ((opt = getopt(argc, argv, "qfsSrpih")) != -1) {
+	while ((opt = getopt(argc, argv, "qn:e:w:t:k:j:fsSrpigh")) != -1) {
 		switch (opt) {
 		case 'q':
 			quiet = true;
 			break;
+		case 'n':
+			if (strmatch(optarg, "ema")) {
+				__predictor = PREDICTOR_AVERAGE;
+			} else if (optarg[0] == 'q' && atoi(optarg + 1) > 0 && atoi(optarg + 1) <= 100) {
+				__predictor = PREDICTOR_QUANTILE;
+				__quantile = atoi(optarg + 1);
+			} else {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'e':
+			__export.file = optarg;
+			break;
+		case 'w':
+			if ((__export.every = atoi(optarg)) == 0) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 't':
+			if (!__setup_trace(optarg)) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			if ((__import_tick = atoi(optarg)) == 0) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'j':
+			if ((__swf.tick = atoi(optarg)) == 0) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
 
 		case 'f':
 			sched = &fifo_scheduler;
@@ -458,6 +5127,9 @@ int main(int argc, char * const argv[])
 		case 'i':
 			sched = &pip_scheduler;
 			break;
+		case 'g':
+			sched = &fair_scheduler;
+			break;
 		case 'h':
 		default:
 			__print_usage(argv[0]);
@@ -474,7 +5146,24 @@ int main(int argc, char * const argv[])
 
 	__initialize();
 
-	if (!__load_script(scriptfile)) {
+	if (__swf.tick ? !__open_swf(scriptfile) :
+			__import_tick ? !__import_trace(scriptfile) : !__load_script(scriptfile)) {
+		return EXIT_FAILURE;
+	}
+
+	__initialize_cpus();
+
+	/* Simulate the variants of the scenario instead if sweeping */
+	if (__nr_lanes) {
+		return __simulate_batch() ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (__predictor != PREDICTOR_NONE && __simulate_clairvoyant()) {
+		fprintf(stderr, "Failed to simulate with the clairvoyance\n");
+		return EXIT_FAILURE;
+	}
+
+	if (__export.file && !__open_export()) {
 		return EXIT_FAILURE;
 	}
 
@@ -484,10 +5173,17 @@ int main(int argc, char * const argv[])
 
 	__do_simulation();
 
+	if (__trace.reservoir) __flush_kept_events();
+
+	if (__export.fp) fclose(__export.fp);
+	free(__export.tmpfile);
+
 	if (sched->finalize) {
 		sched->finalize();
 	}
 
+	__report();
+
 	return EXIT_SUCCESS;
 }
 /*          ******        DO NOT MODIFY THIS FILE        ******       */
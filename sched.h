@@ -73,6 +73,18 @@ struct scheduler {
 	void (*exiting)(struct process *);
 
 
+	/***********************************************************************
+	 * void prio_changed(struct process *process, unsigned int old_prio)
+	 *
+	 * DESCRIPTION
+	 *   Called when the framework changed the priority of @process from
+	 *   @old_prio to @process->prio. You may reposition @process in your
+	 *   own data structures. You may leave this function NULL if you don't
+	 *   need it.
+	 */
+	void (*prio_changed)(struct process *, unsigned int);
+
+
 	/***********************************************************************
 	 * struct process *schedule(void)
 	 *
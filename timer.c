@@ -0,0 +1,128 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+
+#include "types.h"
+#include "list_head.h"
+#include "timer.h"
+
+/**
+ * Hashed hierarchical timing wheel
+ *
+ * Level 0 has a slot for each of the next WHEEL_SIZE ticks, and each slot of
+ * level n covers WHEEL_SIZE times longer period than the one of level n-1.
+ * A timer is hashed into the slot of the lowest level that covers its
+ * expiration time, so arming and disarming a timer take O(1). Whenever
+ * level n-1 wraps around, the timers in the next slot of level n are
+ * cascaded down to the lower levels. Each timer is cascaded at most once per
+ * level, so expiring timers takes amortized O(1).
+ */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define NR_LEVELS	4
+
+static struct list_head __wheel[NR_LEVELS][WHEEL_SIZE];
+static unsigned int __wheel_now = 0;	/* The tick to expire timers next */
+static bool __wheel_initialized = false;
+
+static void __init_wheel(void)
+{
+	for (int i = 0; i < NR_LEVELS; i++) {
+		for (int j = 0; j < WHEEL_SIZE; j++) {
+			INIT_LIST_HEAD(&__wheel[i][j]);
+		}
+	}
+	__wheel_initialized = true;
+}
+
+static void __enqueue_timer(struct timer *timer)
+{
+	unsigned int expires = timer->expires;
+	unsigned int delta;
+	int level;
+
+	/* Timers in the past expire at the next run */
+	if (expires < __wheel_now) expires = __wheel_now;
+	delta = expires - __wheel_now;
+
+	for (level = 0; level < NR_LEVELS - 1; level++) {
+		if (delta < 1U << (WHEEL_BITS * (level + 1))) break;
+	}
+
+	/* Timers beyond the wheel wait in the farthest slot, and get re-hashed */
+	if (delta >= 1U << (WHEEL_BITS * NR_LEVELS)) {
+		expires = __wheel_now + (1U << (WHEEL_BITS * NR_LEVELS)) - 1;
+	}
+
+	list_add_tail(&timer->list,
+			&__wheel[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK]);
+}
+
+static void __cascade_timers(int level, unsigned int index)
+{
+	struct timer *t, *tmp;
+	LIST_HEAD(timers);
+
+	list_splice_init(&__wheel[level][index], &timers);
+
+	list_for_each_entry_safe(t, tmp, &timers, list) {
+		list_del_init(&t->list);
+		__enqueue_timer(t);
+	}
+}
+
+void add_timer(struct timer *timer, unsigned int expires)
+{
+	if (!__wheel_initialized) __init_wheel();
+
+	list_del_init(&timer->list);
+	timer->expires = expires;
+
+	__enqueue_timer(timer);
+}
+
+void del_timer(struct timer *timer)
+{
+	list_del_init(&timer->list);
+}
+
+void run_timers(unsigned int now)
+{
+	if (!__wheel_initialized) __init_wheel();
+
+	for (; __wheel_now <= now; __wheel_now++) {
+		unsigned int index = __wheel_now & WHEEL_MASK;
+		struct list_head *slot = &__wheel[0][index];
+
+		/* Cascade down the timers of the upper levels when the lower wraps */
+		for (int level = 1; level < NR_LEVELS && index == 0; level++) {
+			index = (__wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+			__cascade_timers(level, index);
+		}
+
+		while (!list_empty(slot)) {
+			struct timer *t = list_first_entry(slot, struct timer, list);
+
+			list_del_init(&t->list);
+			if (t->expires > __wheel_now) {
+				__enqueue_timer(t);
+				continue;
+			}
+			t->function(t);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+/***********************************************************************
+ * Timers
+ *
+ * DESCRIPTION
+ *   A timer calls back @function at the beginning of tick @expires, before
+ *   the framework forks processes and calls the scheduler for the tick.
+ *   The function may re-arm the timer with add_timer(). Timers are kept in
+ *   a hashed hierarchical timing wheel, so arming and disarming a timer
+ *   take O(1), and expiring timers takes amortized O(1) regardless of the
+ *   number of pending timers.
+ */
+struct timer {
+	unsigned int expires;			/* When to fire the timer */
+	void (*function)(struct timer *);
+									/* Callback function */
+
+	struct list_head list;			/* list head for pending timers */
+};
+
+static inline void timer_setup(struct timer *timer,
+		void (*function)(struct timer *))
+{
+	timer->expires = 0;
+	timer->function = function;
+	INIT_LIST_HEAD(&timer->list);
+}
+
+static inline bool timer_pending(const struct timer *timer)
+{
+	return !list_empty(&timer->list);
+}
+
+/***********************************************************************
+ * add_timer(), del_timer()
+ *
+ * DESCRIPTION
+ *   Arm @timer to fire at tick @expires, or disarm it. Arming a pending
+ *   timer moves it to @expires.
+ */
+void add_timer(struct timer *timer, unsigned int expires);
+void del_timer(struct timer *timer);
+
+/***********************************************************************
+ * run_timers()
+ *
+ * DESCRIPTION
+ *   Fire the timers expiring at or before @now. Called by the framework.
+ */
+void run_timers(unsigned int now);
+
+#endif